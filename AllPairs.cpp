@@ -0,0 +1,248 @@
+/*
+ * File:   AllPairs.cpp
+ * Author: bret and daniel
+ */
+
+#include <new>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "AllPairs.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+bool check_index(int i, int n, const char *msg);
+
+// The matrix rows start on cache line (and vector) boundaries
+static const size_t Alignment = 64;
+
+static const int Tile = AllPairs::Tile;
+
+static void min_plus_row(double *c, const double *b, double a)
+// c[j] = min(c[j], a + b[j]) for the 'Tile' entries of a tile row
+{
+#if defined(__AVX512F__)
+	__m512d va = _mm512_set1_pd(a);
+	for (int j = 0; j < Tile; j += 8) {
+		__m512d sum = _mm512_add_pd(va, _mm512_load_pd(b + j));
+		_mm512_store_pd(c + j, _mm512_min_pd(_mm512_load_pd(c + j), sum));
+	}
+#elif defined(__AVX__)
+	__m256d va = _mm256_set1_pd(a);
+	for (int j = 0; j < Tile; j += 4) {
+		__m256d sum = _mm256_add_pd(va, _mm256_load_pd(b + j));
+		_mm256_store_pd(c + j, _mm256_min_pd(_mm256_load_pd(c + j), sum));
+	}
+#elif defined(__SSE2__)
+	__m128d va = _mm_set1_pd(a);
+	for (int j = 0; j < Tile; j += 2) {
+		__m128d sum = _mm_add_pd(va, _mm_load_pd(b + j));
+		_mm_store_pd(c + j, _mm_min_pd(_mm_load_pd(c + j), sum));
+	}
+#else
+	for (int j = 0; j < Tile; j++) {
+		double sum = a + b[j];
+		if (sum < c[j])
+			c[j] = sum;
+	}
+#endif
+}
+
+static void min_plus_row(double *c, const double *b, double a,
+	int *next_c, int next_a)
+// The same, also setting next_c[j] to 'next_a' wherever c[j] shrinks
+{
+#if defined(__AVX512F__)
+	__m512d va = _mm512_set1_pd(a);
+	for (int j = 0; j < Tile; j += 8) {
+		__m512d sum = _mm512_add_pd(va, _mm512_load_pd(b + j));
+		__mmask8 less = _mm512_cmp_pd_mask(sum, _mm512_load_pd(c + j),
+			_CMP_LT_OQ);
+		if (less == 0)
+			continue;
+		_mm512_mask_store_pd(c + j, less, sum);
+		for (int h = 0; h < 8; h++)
+			if (less & (1 << h))
+				next_c[j + h] = next_a;
+	}
+#elif defined(__AVX__)
+	__m256d va = _mm256_set1_pd(a);
+	for (int j = 0; j < Tile; j += 4) {
+		__m256d sum = _mm256_add_pd(va, _mm256_load_pd(b + j));
+		__m256d cj = _mm256_load_pd(c + j);
+		int less = _mm256_movemask_pd(_mm256_cmp_pd(sum, cj, _CMP_LT_OQ));
+		if (less == 0)
+			continue;
+		_mm256_store_pd(c + j, _mm256_min_pd(cj, sum));
+		for (int h = 0; h < 4; h++)
+			if (less & (1 << h))
+				next_c[j + h] = next_a;
+	}
+#elif defined(__SSE2__)
+	__m128d va = _mm_set1_pd(a);
+	for (int j = 0; j < Tile; j += 2) {
+		__m128d sum = _mm_add_pd(va, _mm_load_pd(b + j));
+		__m128d cj = _mm_load_pd(c + j);
+		int less = _mm_movemask_pd(_mm_cmplt_pd(sum, cj));
+		if (less == 0)
+			continue;
+		_mm_store_pd(c + j, _mm_min_pd(cj, sum));
+		for (int h = 0; h < 2; h++)
+			if (less & (1 << h))
+				next_c[j + h] = next_a;
+	}
+#else
+	for (int j = 0; j < Tile; j++) {
+		double sum = a + b[j];
+		if (sum < c[j]) {
+			c[j] = sum;
+			next_c[j] = next_a;
+		}
+	}
+#endif
+}
+
+static void relax_tile(double *c, const double *a, const double *b,
+	int *next_c, const int *next_a, int stride)
+// One Floyd-Warshall step over a tile: for each k of the tile in turn,
+// c[i][j] = min(c[i][j], a[i][k] + b[k][j]).  The tiles are 'Tile' wide
+// inside a matrix with rows 'stride' long, and 'c' may be 'a' or 'b' (a
+// Floyd-Warshall step never changes row or column k itself).  If the
+// next-hop tiles are given, next_c[i][j] becomes next_a[i][k] wherever
+// c[i][j] shrinks.
+{
+	for (int k = 0; k < Tile; k++) {
+		const double *b_k = b + (size_t)k*stride;
+		for (int i = 0; i < Tile; i++) {
+			double a_ik = a[(size_t)i*stride + k];
+			if (a_ik == InfiniteDistance)
+				continue;
+			if (next_c)
+				min_plus_row(c + (size_t)i*stride, b_k, a_ik,
+					next_c + (size_t)i*stride, next_a[(size_t)i*stride + k]);
+			else
+				min_plus_row(c + (size_t)i*stride, b_k, a_ik);
+		}
+	}
+}
+
+static void parallel_for(ThreadPool& pool, int count,
+	const function<void(int)>& body)
+// Runs 'body(k)' for k = 0..count-1 on the threads of 'pool'
+{
+	atomic<int> next_item(0);
+	pool.run([&](int) {
+		for (int k = next_item++; k < count; k = next_item++)
+			body(k);
+	});
+}
+
+AllPairs::AllPairs(const Graph& graph, ThreadPool& pool, bool with_next_hops)
+// Copies the arcs of 'graph' into the distance matrix (and the next-hop
+// matrix, if it is wanted), and runs Floyd-Warshall on them
+{
+	n = graph.node_count();
+	stride = (n + Tile - 1) / Tile * Tile;
+	size_t entries = (size_t)stride*stride;
+
+	dist = (double *)operator new[](entries*sizeof(double),
+		align_val_t(Alignment));
+	fill(dist, dist + entries, InfiniteDistance);
+	for (int i = 0; i < stride; i++)
+		dist[(size_t)i*stride + i] = 0;
+
+	next = NULL;
+	if (with_next_hops) {
+		next = (int *)operator new[](entries*sizeof(int),
+			align_val_t(Alignment));
+		fill(next, next + entries, -1);
+	}
+
+	for (int i = 0; i < n; i++) {
+		for (int a = graph.first_arc(i); a < graph.last_arc(i); a++) {
+			int j = graph.arc_target(a);
+			if (j == i)
+				continue;
+			dist[(size_t)i*stride + j] = graph.arc_weight(a);
+			if (next)
+				next[(size_t)i*stride + j] = j;
+		}
+	}
+
+	run(pool);
+}
+
+AllPairs::~AllPairs()
+{
+	operator delete[](dist, align_val_t(Alignment));
+	if (next)
+		operator delete[](next, align_val_t(Alignment));
+}
+
+void AllPairs::run(ThreadPool& pool)
+// The blocked Floyd-Warshall: round 'kb' does the Floyd-Warshall steps
+// for the nodes in tile column 'kb'.  The diagonal tile (kb, kb) only
+// depends on itself; the other tiles in row and column 'kb' only depend
+// on themselves and the diagonal tile; and the rest only depend on the
+// tiles in row and column 'kb' that line up with them.
+{
+	const int tiles = stride / Tile;
+	for (int kb = 0; kb < tiles; kb++) {
+		double *diagonal = tile(kb, kb);
+		int *next_diagonal = next_tile(kb, kb);
+		relax_tile(diagonal, diagonal, diagonal,
+			next_diagonal, next_diagonal, stride);
+		if (tiles == 1)
+			break;
+
+		// row 'kb' (the first 'tiles - 1') then column 'kb'
+		parallel_for(pool, 2*(tiles - 1), [&](int t) {
+			int other = t % (tiles - 1);
+			if (other >= kb)
+				other++;
+			if (t < tiles - 1)
+				relax_tile(tile(kb, other), diagonal, tile(kb, other),
+					next_tile(kb, other), next_diagonal, stride);
+			else
+				relax_tile(tile(other, kb), tile(other, kb), diagonal,
+					next_tile(other, kb), next_tile(other, kb), stride);
+		});
+
+		// everything else
+		parallel_for(pool, (tiles - 1)*(tiles - 1), [&](int t) {
+			int ib = t / (tiles - 1);
+			int jb = t % (tiles - 1);
+			if (ib >= kb)
+				ib++;
+			if (jb >= kb)
+				jb++;
+			relax_tile(tile(ib, jb), tile(ib, kb), tile(kb, jb),
+				next_tile(ib, jb), next_tile(ib, kb), stride);
+		});
+	}
+}
+
+void AllPairs::path(int i, int j, vector<int>& path) const
+// Follows the next-hop matrix from 'i' to 'j'
+{
+	path.clear();
+	if (!check_index(i, n, "path() (start index)")
+		|| !check_index(j, n, "path() (end index)"))
+		return;
+	if (!next) {
+		cerr << "path(): the next-hop matrix was not computed\n";
+		return;
+	}
+	if (distance(i, j) == InfiniteDistance)
+		return;
+
+	path.push_back(i);
+	for (int v = i; v != j; v = next_hop(v, j))
+		path.push_back(next_hop(v, j));
+}
@@ -0,0 +1,74 @@
+/*
+ * File:   AllPairs.h
+ * Author: bret and daniel
+ *
+ * All-pairs shortest path distances by a blocked Floyd-Warshall, for
+ * small to medium dense graphs (a few thousand nodes).
+ *
+ * The arcs are copied into one contiguous n by n distance matrix, padded
+ * out to a whole number of square tiles.  Each round of Floyd-Warshall
+ * then works a tile at a time: first the tile on the diagonal, then the
+ * other tiles in its row and column (which depend only on it), then all
+ * the rest (which depend only on those).  The tiles of the last two
+ * steps are independent of each other, so they run in parallel, and
+ * each tile stays in the cache while it is worked on.  The inner
+ * "min-plus" loop is vectorized with AVX-512 or AVX when the compiler
+ * targets them (e.g., -mavx2 or -march=native), with SSE2 on any other
+ * x86-64, and is plain C++ elsewhere.
+ *
+ * The next-hop matrix, for following the paths, is optional: it takes
+ * another n by n ints, and updating it slows the inner loop down.
+ */
+
+#ifndef __ALLPAIRS_H
+#define __ALLPAIRS_H
+
+#include <vector>
+
+#include "Graph.h"
+
+using namespace std;
+
+class ThreadPool;
+
+class AllPairs {
+ public:
+
+  /* Constructor: computes the distances between all the nodes of 'graph' */
+  AllPairs( const Graph& graph, ThreadPool& pool, bool with_next_hops = false );
+  ~AllPairs();
+
+  int node_count() const { return n; }
+
+  // The distance from 'i' to 'j' (InfiniteDistance if there is no path)
+  double distance( int i, int j ) const { return dist[(size_t)i*stride + j]; }
+
+  // The node after 'i' on a shortest path to 'j' (-1 if there is no path,
+  // or if 'i' is 'j'), if the next-hop matrix was asked for
+  bool has_next_hops() const { return next != NULL; }
+  int next_hop( int i, int j ) const { return next[(size_t)i*stride + j]; }
+
+  // Sets 'path' to the nodes along a shortest path from 'i' to 'j'
+  // (or empty, if there is none); this needs the next-hop matrix
+  void path( int i, int j, vector<int>& path ) const;
+
+  static const int Tile = 64;  // width of the tiles, in matrix entries
+
+ private:
+  int n;
+  int stride;     // row length of 'dist': 'n' rounded up to a whole tile
+  double *dist;   // the distance matrix (aligned for the vector loads)
+  int *next;      // the next-hop matrix (laid out the same way), or NULL
+
+  double *tile( int i, int j ) { return dist + ((size_t)i*stride + j)*Tile; }
+  int *next_tile( int i, int j ) {
+    return (next ? next + ((size_t)i*stride + j)*Tile : NULL);
+  }
+  void run( ThreadPool& pool );
+
+  // (not copyable)
+  AllPairs( const AllPairs& );
+  AllPairs& operator=( const AllPairs& );
+};
+
+#endif
@@ -0,0 +1,647 @@
+/*
+ * File:   ContractionHierarchy.cpp
+ * Author: bret and daniel
+ */
+
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+#include "ContractionHierarchy.h"
+
+using namespace std;
+
+bool check_index(int i, int n, const char *msg);
+bool check_node_index(int index, int n_nodes,
+	const string& source_name, int line_num);
+bool check_arc_indices(int start, int end, int n_nodes,
+	const string& source_name, int line_num);
+
+/*****************/
+/* Preprocessing */
+/*****************/
+
+// A witness search gives up after settling this many nodes (when a node
+// is contracted, or only estimating the shortcuts for its priority)
+static const int WitnessSettled = 500;
+static const int EstimateSettled = 50;
+
+// An arc of the graph that remains during the contraction
+struct Link {
+	int node;     // the other end
+	int middle;   // the node a shortcut bypasses, or -1
+	double weight;
+};
+
+// The graph that remains during the contraction, and the state of the
+// witness searches
+struct Remaining {
+	vector<vector<Link> > out, in;  // arcs leaving and entering each node
+	vector<double> dist;            // witness search distances
+	vector<int> touched;            // nodes whose 'dist' is set
+	IndexedHeap heap;
+
+	Remaining(int n) : out(n), in(n), dist(n, InfiniteDistance), heap(n) {}
+};
+
+static void remove_link(vector<Link>& links, int node)
+// Removes the link to 'node' from 'links' (if there is one)
+{
+	for (size_t k = 0; k < links.size(); k++)
+		if (links[k].node == node) {
+			links[k] = links.back();
+			links.pop_back();
+			return;
+		}
+}
+
+static void add_link(Remaining& r, int i, int j, double weight, int middle)
+// Adds the arc i->j, or shortens it if it is there and longer
+{
+	for (size_t k = 0; k < r.out[i].size(); k++) {
+		Link& link = r.out[i][k];
+		if (link.node != j)
+			continue;
+		if (link.weight <= weight)
+			return;
+		link.weight = weight;
+		link.middle = middle;
+		for (size_t h = 0; h < r.in[j].size(); h++)
+			if (r.in[j][h].node == i) {
+				r.in[j][h].weight = weight;
+				r.in[j][h].middle = middle;
+			}
+		return;
+	}
+	Link out = { j, middle, weight };
+	Link in = { i, middle, weight };
+	r.out[i].push_back(out);
+	r.in[j].push_back(in);
+}
+
+static void witness_search(Remaining& r, int source, int avoid,
+	double limit, int max_settled)
+// Runs Dijkstra's algorithm from 'source' in the remaining graph without
+// going through 'avoid', until the distances up to 'limit' are known or
+// 'max_settled' nodes are settled.  The distances are left in 'r.dist'
+// (those not found are too long, as far as the search can tell).
+{
+	for (size_t k = 0; k < r.touched.size(); k++)
+		r.dist[r.touched[k]] = InfiniteDistance;
+	r.touched.clear();
+	r.heap.clear();
+
+	r.dist[source] = 0;
+	r.touched.push_back(source);
+	r.heap.push(source, 0);
+	for (int settled = 0; !r.heap.empty() && settled < max_settled;
+		settled++)
+	{
+		if (r.heap.top_key() > limit)
+			break;
+		int u = r.heap.pop();
+		for (size_t k = 0; k < r.out[u].size(); k++) {
+			const Link& link = r.out[u][k];
+			int v = link.node;
+			if (v == avoid)
+				continue;
+			double d = r.dist[u] + link.weight;
+			if (d < r.dist[v]) {
+				if (r.dist[v] == InfiniteDistance)
+					r.touched.push_back(v);
+				r.dist[v] = d;
+				r.heap.push_or_decrease(v, d);
+			}
+		}
+	}
+}
+
+static int contract_node(Remaining& r, int v, bool estimate)
+// Finds the shortcuts needed to take 'v' out of the remaining graph: for
+// each pair of neighbors u->v->x, the arc u->x is needed unless a search
+// finds a "witness" path from 'u' to 'x' that avoids 'v' and is no
+// longer.  Unless 'estimate' is set, the shortcuts are added.
+// Returns the number of shortcuts.
+{
+	int shortcuts = 0;
+	for (size_t a = 0; a < r.in[v].size(); a++) {
+		int u = r.in[v][a].node;
+		double to_v = r.in[v][a].weight;
+
+		double limit = 0;
+		for (size_t b = 0; b < r.out[v].size(); b++)
+			if (r.out[v][b].node != u)
+				limit = max(limit, to_v + r.out[v][b].weight);
+		if (limit == 0)
+			continue;
+
+		witness_search(r, u, v, limit,
+			(estimate ? EstimateSettled : WitnessSettled));
+		for (size_t b = 0; b < r.out[v].size(); b++) {
+			int x = r.out[v][b].node;
+			double through_v = to_v + r.out[v][b].weight;
+			if (x == u || r.dist[x] <= through_v)
+				continue;
+			shortcuts++;
+			if (!estimate)
+				add_link(r, u, x, through_v, v);
+		}
+	}
+	return shortcuts;
+}
+
+static double priority(Remaining& r, int v, int deleted_neighbors)
+// The contraction priority of 'v' (lowest goes first): twice the "edge
+// difference", i.e., the shortcuts contracting 'v' would add less the
+// arcs it would remove, plus the number of its neighbors already
+// contracted, which spreads the contraction evenly over the graph
+{
+	int removed = (int)(r.in[v].size() + r.out[v].size());
+	return 2*(contract_node(r, v, true) - removed) + deleted_neighbors;
+}
+
+ContractionHierarchy::ContractionHierarchy(const Graph& graph)
+// Constructs the hierarchy of 'graph'
+{
+	build(graph);
+	init_queries();
+}
+
+void ContractionHierarchy::build(const Graph& graph)
+// Orders the nodes and contracts them one at a time.  The order is by
+// 'priority', which is kept up to date "lazily": the priority of the
+// next node is recomputed before it is contracted, and if it is no
+// longer the lowest, the node goes back into the queue.  (Recomputing
+// the neighbors of each contracted node as well takes about four times
+// as long, for no better a hierarchy.)
+{
+	n = graph.node_count();
+	ranks.assign(n, -1);
+
+	Remaining r(n);
+	for (int i = 0; i < n; i++)
+		for (int a = graph.first_arc(i); a < graph.last_arc(i); a++)
+			if (graph.arc_target(a) != i)
+				add_link(r, i, graph.arc_target(a), graph.arc_weight(a), -1);
+
+	vector<int> deleted(n, 0);
+	IndexedHeap order(n);
+	for (int v = 0; v < n; v++)
+		order.push(v, priority(r, v, 0));
+
+	vector<vector<Arc> > up_arcs(n), down_arcs(n);
+	vector<int> neighbors;
+	int next_rank = 0;
+	while (!order.empty()) {
+		int v = order.pop();
+		double p = priority(r, v, deleted[v]);
+		if (!order.empty() && p > order.top_key()) {
+			order.push(v, p);
+			continue;
+		}
+
+		contract_node(r, v, false);
+		ranks[v] = next_rank++;
+
+		// the arcs that remain at 'v' join the hierarchy, and 'v' leaves
+		// the remaining graph
+		neighbors.clear();
+		for (size_t k = 0; k < r.out[v].size(); k++) {
+			const Link& link = r.out[v][k];
+			Arc arc = { link.node, link.middle, link.weight };
+			up_arcs[v].push_back(arc);
+			remove_link(r.in[link.node], v);
+			neighbors.push_back(link.node);
+		}
+		for (size_t k = 0; k < r.in[v].size(); k++) {
+			const Link& link = r.in[v][k];
+			Arc arc = { link.node, link.middle, link.weight };
+			down_arcs[v].push_back(arc);
+			remove_link(r.out[link.node], v);
+			neighbors.push_back(link.node);
+		}
+		r.out[v].clear();
+		r.in[v].clear();
+
+		sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(unique(neighbors.begin(), neighbors.end()),
+			neighbors.end());
+		for (size_t k = 0; k < neighbors.size(); k++)
+			deleted[neighbors[k]]++;
+	}
+
+	set_arcs(up_arcs, down_arcs);
+}
+
+void ContractionHierarchy::set_arcs(vector<vector<Arc> >& up_arcs,
+	vector<vector<Arc> >& down_arcs)
+// Packs the arcs of each node into 'up' and 'down', sorted by node
+{
+	up_offsets.assign(n + 1, 0);
+	down_offsets.assign(n + 1, 0);
+	up.clear();
+	down.clear();
+	for (int i = 0; i < n; i++) {
+		sort(up_arcs[i].begin(), up_arcs[i].end());
+		sort(down_arcs[i].begin(), down_arcs[i].end());
+		up.insert(up.end(), up_arcs[i].begin(), up_arcs[i].end());
+		down.insert(down.end(), down_arcs[i].begin(), down_arcs[i].end());
+		up_offsets[i + 1] = (int)up.size();
+		down_offsets[i + 1] = (int)down.size();
+	}
+}
+
+ContractionHierarchy::~ContractionHierarchy()
+{
+	delete heap[0];
+	delete heap[1];
+}
+
+int ContractionHierarchy::shortcut_count() const
+// Returns the number of arcs of the hierarchy that are shortcuts
+{
+	int count = 0;
+	for (size_t k = 0; k < up.size(); k++)
+		if (up[k].middle >= 0)
+			count++;
+	for (size_t k = 0; k < down.size(); k++)
+		if (down[k].middle >= 0)
+			count++;
+	return count;
+}
+
+
+/***********/
+/* Queries */
+/***********/
+
+void ContractionHierarchy::init_queries()
+// Sets up the query state for 'n' nodes
+{
+	for (int side = 0; side < 2; side++) {
+		dist[side].assign(n, InfiniteDistance);
+		parent[side].assign(n, -1);
+		touched[side].clear();
+		heap[side] = new IndexedHeap(n);
+	}
+}
+
+int ContractionHierarchy::find_up(int i, int j) const
+// Returns the index in 'up' of the arc i->j (which must be there)
+{
+	vector<Arc>::const_iterator first = up.begin() + up_offsets[i];
+	vector<Arc>::const_iterator last = up.begin() + up_offsets[i + 1];
+	Arc key = { j, -1, 0 };
+	return (int)(lower_bound(first, last, key) - up.begin());
+}
+
+int ContractionHierarchy::find_down(int i, int j) const
+// Returns the index in 'down' of the arc j->i (which must be there)
+{
+	vector<Arc>::const_iterator first = down.begin() + down_offsets[i];
+	vector<Arc>::const_iterator last = down.begin() + down_offsets[i + 1];
+	Arc key = { j, -1, 0 };
+	return (int)(lower_bound(first, last, key) - down.begin());
+}
+
+ShortestPath ContractionHierarchy::query(int source_i, int dest_i)
+// A bidirectional Dijkstra over the hierarchy: the forward search from
+// 'source_i' follows the 'up' arcs, the backward search from 'dest_i'
+// follows the 'down' arcs in reverse, so both only climb in rank.  The
+// shortest path goes up to its highest ranked node and back down, so it
+// is the best sum of the two distances over the nodes both reach.  Each
+// search stops once its next key is no shorter than the best path.
+// A node that can be reached more cheaply from a higher ranked node
+// (through an arc the search does not follow) is not on a shortest
+// path, so its arcs are not relaxed ("stall-on-demand").
+{
+	ShortestPath result;
+	if (!check_index(source_i, n, "query() (source index)"))
+		return result;
+	if (!check_index(dest_i, n, "query() (destination index)"))
+		return result;
+
+	// reset what the last query set
+	for (int side = 0; side < 2; side++) {
+		for (size_t k = 0; k < touched[side].size(); k++) {
+			dist[side][touched[side][k]] = InfiniteDistance;
+			parent[side][touched[side][k]] = -1;
+		}
+		touched[side].clear();
+		heap[side]->clear();
+	}
+
+	int start[2] = { source_i, dest_i };
+	for (int side = 0; side < 2; side++) {
+		dist[side][start[side]] = 0;
+		touched[side].push_back(start[side]);
+		heap[side]->push(start[side], 0);
+	}
+
+	// the forward search relaxes the 'up' arcs and stalls on the 'down'
+	// arcs, and the backward search the other way around
+	const vector<int> *offsets[2] = { &up_offsets, &down_offsets };
+	const vector<Arc> *arcs[2] = { &up, &down };
+
+	double best = InfiniteDistance;
+	int meet = -1;
+	for (;;) {
+		bool active[2];
+		for (int side = 0; side < 2; side++)
+			active[side] = (!heap[side]->empty()
+				&& heap[side]->top_key() < best);
+		if (!active[0] && !active[1])
+			break;
+		int side = (active[0] && (!active[1]
+			|| heap[0]->top_key() <= heap[1]->top_key()) ? 0 : 1);
+
+		int u = heap[side]->pop();
+		result.settled++;
+		double d = dist[side][u];
+		if (d + dist[1 - side][u] < best) {
+			best = d + dist[1 - side][u];
+			meet = u;
+		}
+
+		const vector<int>& stall_offsets = *offsets[1 - side];
+		const vector<Arc>& stall_arcs = *arcs[1 - side];
+		bool stalled = false;
+		for (int k = stall_offsets[u]; k < stall_offsets[u + 1]; k++)
+			if (dist[side][stall_arcs[k].node] + stall_arcs[k].weight < d) {
+				stalled = true;
+				break;
+			}
+		if (stalled)
+			continue;
+
+		const vector<int>& relax_offsets = *offsets[side];
+		const vector<Arc>& relax_arcs = *arcs[side];
+		for (int k = relax_offsets[u]; k < relax_offsets[u + 1]; k++) {
+			int v = relax_arcs[k].node;
+			double dv = d + relax_arcs[k].weight;
+			if (dv < dist[side][v]) {
+				if (dist[side][v] == InfiniteDistance)
+					touched[side].push_back(v);
+				dist[side][v] = dv;
+				parent[side][v] = u;
+				heap[side]->push_or_decrease(v, dv);
+			}
+		}
+	}
+
+	result.distance = best;
+	if (meet < 0)
+		return result;
+
+	// climb from 'source_i' to 'meet', then back down to 'dest_i',
+	// expanding the shortcuts along the way
+	vector<int> climb;
+	for (int v = meet; v != -1; v = parent[0][v])
+		climb.push_back(v);
+	reverse(climb.begin(), climb.end());
+	result.path.push_back(source_i);
+	for (size_t k = 1; k < climb.size(); k++) {
+		int a = find_up(climb[k - 1], climb[k]);
+		unpack(climb[k - 1], climb[k], up[a].middle, result.path);
+	}
+	for (int v = meet; parent[1][v] != -1; v = parent[1][v])
+		unpack(v, parent[1][v], down[find_down(parent[1][v], v)].middle,
+			result.path);
+	return result;
+}
+
+void ContractionHierarchy::unpack(int i, int j, int middle,
+	vector<int>& path) const
+// Appends the nodes of the original graph on the arc i->j after 'i' to
+// 'path'.  A shortcut i->j bypassing 'middle' stands for i->middle
+// (kept at 'middle' as a 'down' arc) followed by middle->j (an 'up' arc),
+// and either of those may be a shortcut too.
+{
+	struct Step { int i, j, middle; };
+	vector<Step> stack;
+	Step first = { i, j, middle };
+	stack.push_back(first);
+	while (!stack.empty()) {
+		Step s = stack.back();
+		stack.pop_back();
+		if (s.middle < 0) {
+			path.push_back(s.j);
+			continue;
+		}
+		// (the first half goes on top, so it is expanded first)
+		Step second_half = { s.middle, s.j,
+			up[find_up(s.middle, s.j)].middle };
+		Step first_half = { s.i, s.middle,
+			down[find_down(s.middle, s.i)].middle };
+		stack.push_back(second_half);
+		stack.push_back(first_half);
+	}
+}
+
+
+/****************/
+/* Input/Output */
+/****************/
+
+ContractionHierarchy::ContractionHierarchy(const string& filename)
+// Constructs the hierarchy saved in 'filename'
+{
+	ifstream in(filename.c_str());
+	if (!in) {
+		cerr << "Can't read from " << filename << ".  Exiting.\n";
+		exit(1);
+	}
+	read(in, filename);
+}
+
+void ContractionHierarchy::read(istream& in, const string& source_name)
+// Reads a hierarchy in the format described in "ContractionHierarchy.h"
+// from 'in'.  As with 'Graph::read', errors in the input are reported
+// with the 'source_name' and line number, and the program exits.
+{
+	string magic;
+	in >> magic;
+	if (magic != "ContractionHierarchy") {
+		cerr << "input source '" << source_name
+			<< "' is not in ContractionHierarchy format\n";
+		exit(1);
+	}
+	int64_t m;
+	in >> n >> m;
+	if (!in || n < 0 || m < 0) {
+		cerr << source_name << ":2 error: invalid node or arc count\n";
+		exit(1);
+	}
+	ranks.assign(n, -1);
+
+	// the arcs are sorted into 'up' and 'down' by the ranks of their ends,
+	// so they are kept until all the ranks are known
+	struct Record { int start, end, middle; double weight; int line; };
+	vector<Record> records;
+
+	int line_num = 2;
+	string key;
+	while (in >> key) {
+		line_num++;
+		if (key.at(0) == '#') {
+			string line;
+			getline(in, line);
+		}
+		else if (key == "rank") {
+			int index, r;
+			in >> index >> r;
+			if (!in) {
+				cerr << source_name << ":" << line_num
+					<< " error: invalid rank line\n";
+				exit(1);
+			}
+			if (!check_node_index(index, n, source_name, line_num))
+				exit(1);
+			if (r < 0 || r >= n || ranks[index - 1] != -1) {
+				cerr << source_name << ":" << line_num
+					<< " error: invalid rank " << r << " for node "
+					<< index << endl;
+				exit(1);
+			}
+			ranks[index - 1] = r;
+		}
+		else if (key == "arc") {
+			Record rec;
+			in >> rec.start >> rec.end >> rec.weight >> rec.middle;
+			if (!in) {
+				cerr << source_name << ":" << line_num
+					<< " error: invalid arc line\n";
+				exit(1);
+			}
+			if (!check_arc_indices(rec.start, rec.end, n, source_name, line_num))
+				exit(1);
+			if (rec.middle < 0 || rec.middle > n) {
+				cerr << source_name << ":" << line_num
+					<< " error: invalid middle node " << rec.middle << endl;
+				exit(1);
+			}
+			if (!(rec.weight > 0)) {
+				cerr << source_name << ":" << line_num
+					<< " error: invalid arc weight " << rec.weight << endl;
+				exit(1);
+			}
+			rec.start--;
+			rec.end--;
+			rec.middle--;
+			rec.line = line_num;
+			records.push_back(rec);
+		}
+		else {
+			cerr << source_name << ":" << line_num
+				<< " error: unknown key '" << key << "'\n";
+			exit(1);
+		}
+	}
+
+	// a file cut short at a line boundary reads cleanly up to there, so
+	// the counts are what catch it
+	if ((int64_t)records.size() != m) {
+		cerr << source_name << ":" << line_num << " error: expected " << m
+			<< " arcs, but the file has " << records.size() << endl;
+		exit(1);
+	}
+	// the ranks must be a permutation of 0..n-1
+	vector<bool> rank_used(n, false);
+	for (int i = 0; i < n; i++) {
+		if (ranks[i] < 0 || rank_used[ranks[i]]) {
+			cerr << source_name << ":" << line_num << " error: node "
+				<< i + 1 << " has no rank, or shares one\n";
+			exit(1);
+		}
+		rank_used[ranks[i]] = true;
+	}
+
+	vector<vector<Arc> > up_arcs(n), down_arcs(n);
+	for (size_t k = 0; k < records.size(); k++) {
+		const Record& rec = records[k];
+		if (ranks[rec.start] < ranks[rec.end]) {
+			Arc arc = { rec.end, rec.middle, rec.weight };
+			up_arcs[rec.start].push_back(arc);
+		}
+		else {
+			Arc arc = { rec.start, rec.middle, rec.weight };
+			down_arcs[rec.end].push_back(arc);
+		}
+	}
+	set_arcs(up_arcs, down_arcs);
+
+	// there can only be one arc each way between two nodes, or the
+	// queries can't tell which one a shortcut stands for
+	for (int i = 0; i < n; i++) {
+		for (int k = up_offsets[i] + 1; k < up_offsets[i + 1]; k++)
+			if (up[k].node == up[k - 1].node) {
+				cerr << source_name << ":" << line_num << " error: more than "
+					<< "one arc " << i + 1 << " -> " << up[k].node + 1 << endl;
+				exit(1);
+			}
+		for (int k = down_offsets[i] + 1; k < down_offsets[i + 1]; k++)
+			if (down[k].node == down[k - 1].node) {
+				cerr << source_name << ":" << line_num << " error: more than "
+					<< "one arc " << down[k].node + 1 << " -> " << i + 1 << endl;
+				exit(1);
+			}
+	}
+	// a shortcut start->end must bypass a node ranked below both ends,
+	// with the arcs start->middle and middle->end there to unpack it into
+	for (size_t k = 0; k < records.size(); k++) {
+		const Record& rec = records[k];
+		if (rec.middle < 0)
+			continue;
+		int middle_rank = ranks[rec.middle];
+		if (middle_rank >= ranks[rec.start] || middle_rank >= ranks[rec.end]) {
+			cerr << source_name << ":" << rec.line << " error: middle node "
+				<< rec.middle + 1 << " doesn't rank below both ends\n";
+			exit(1);
+		}
+		int a = find_up(rec.middle, rec.end);
+		int b = find_down(rec.middle, rec.start);
+		if (a == up_offsets[rec.middle + 1] || up[a].node != rec.end
+			|| b == down_offsets[rec.middle + 1] || down[b].node != rec.start) {
+			cerr << source_name << ":" << rec.line << " error: the arcs "
+				<< rec.start + 1 << " -> " << rec.middle + 1 << " -> "
+				<< rec.end + 1 << " that the shortcut bypasses are missing\n";
+			exit(1);
+		}
+	}
+	init_queries();
+}
+
+ostream& ContractionHierarchy::write(ostream& out) const
+// Writes this hierarchy in the format read by 'read'.  The weights are
+// written with enough digits to be read back exactly.
+{
+	out << "ContractionHierarchy\n" << n << " "
+		<< up_offsets[n] + down_offsets[n] << "\n";
+	for (int i = 0; i < n; i++)
+		out << "rank " << i + 1 << " " << ranks[i] << "\n";
+
+	streamsize precision = out.precision(17);
+	for (int i = 0; i < n; i++) {
+		for (int k = up_offsets[i]; k < up_offsets[i + 1]; k++)
+			out << "arc " << i + 1 << " " << up[k].node + 1 << " "
+			<< up[k].weight << " " << up[k].middle + 1 << "\n";
+		for (int k = down_offsets[i]; k < down_offsets[i + 1]; k++)
+			out << "arc " << down[k].node + 1 << " " << i + 1 << " "
+			<< down[k].weight << " " << down[k].middle + 1 << "\n";
+	}
+	out.precision(precision);
+	return out;
+}
+
+bool ContractionHierarchy::save(const string& filename) const
+// Writes this hierarchy to 'filename'.  Returns false if the file
+// can't be written.
+{
+	ofstream out(filename.c_str());
+	if (!out) {
+		cerr << "Can't write to " << filename << endl;
+		return false;
+	}
+	write(out);
+	return (bool)out;
+}
@@ -0,0 +1,111 @@
+/*
+ * File:   ContractionHierarchy.h
+ * Author: bret and daniel
+ *
+ * Contraction Hierarchies, for answering many point-to-point shortest
+ * path queries on a graph that rarely changes.
+ *
+ * Preprocessing ranks the nodes and "contracts" them in rank order: a
+ * node is taken out of the graph, and wherever the only shortest path
+ * between two of its remaining neighbors went through it, a "shortcut"
+ * arc is added between them.  The hierarchy keeps each arc at its lower
+ * ranked end, so every shortest path can be found going only "up" from
+ * the source and only "up" (backward) from the destination.  A query is
+ * a bidirectional Dijkstra over these upward arcs, which settles a few
+ * hundred nodes even on large road networks.
+ *
+ * A hierarchy can be written to a file and read back, so the
+ * preprocessing only has to be done once:
+ *
+ *   ContractionHierarchy
+ *   <number-of-nodes> <number-of-arcs>
+ *   rank <node-index> <rank>
+ *   ...
+ *   arc <start> <end> <weight> <middle>
+ *   ...
+ *
+ * (node indices start at 1, as in the Graph format; <middle> is the node
+ * a shortcut bypasses, or 0 for an arc of the original graph).  Every
+ * node has one rank, the ranks run from 0 to <number-of-nodes> - 1, and
+ * the arc count lets a file that was cut short be caught when it is read.
+ * There is at most one arc each way between two nodes, and the middle of
+ * a shortcut ranks below both its ends, with the two arcs it bypasses in
+ * the file too, so that the queries can unpack it.
+ */
+
+#ifndef __CONTRACTIONHIERARCHY_H
+#define __CONTRACTIONHIERARCHY_H
+
+#include <string>
+#include <iostream>
+#include <vector>
+
+#include "Graph.h"
+#include "IndexedHeap.h"
+
+using namespace std;
+
+class ContractionHierarchy {
+ public:
+
+  /* Constructors */
+  ContractionHierarchy( const Graph& graph );       // preprocesses 'graph'
+  ContractionHierarchy( const string& filename );  // reads a saved hierarchy
+  ContractionHierarchy( istream& in ) { read(in, "input"); }
+  ~ContractionHierarchy();
+
+  int node_count() const { return n; }
+  int arc_count() const { return (int)(up.size() + down.size()); }
+  int shortcut_count() const;             // arcs that are shortcuts
+  int rank( int i ) const { return ranks[i]; }  // contraction order of 'i'
+
+  // The shortest path from 'source_i' to 'dest_i', over the nodes of
+  // the original graph
+  ShortestPath query( int source_i, int dest_i );
+
+  /* Output */
+  ostream& write( ostream& out ) const;
+  bool save( const string& filename ) const;
+
+ private:
+
+  // An arc of the hierarchy, kept at its lower ranked end: 'node' is
+  // the other end, and 'middle' the node a shortcut bypasses (or -1)
+  struct Arc {
+    int node;
+    int middle;
+    double weight;
+    bool operator<( const Arc& a ) const { return node < a.node; }
+  };
+
+  int n;
+  vector<int> ranks;
+
+  // The upward arcs i->j leaving node 'i' are up[up_offsets[i]..[i+1]-1],
+  // and the arcs j->i coming into 'i' from above are down[down_offsets[i]..]
+  // (both sorted by 'node')
+  vector<int> up_offsets, down_offsets;
+  vector<Arc> up, down;
+
+  // Query state, reused from one query to the next: index 0 is the
+  // forward search and 1 the backward search
+  vector<double> dist[2];
+  vector<int> parent[2];    // node each node was reached from, or -1
+  vector<int> touched[2];   // nodes whose 'dist' is set
+  IndexedHeap *heap[2];
+
+  void build( const Graph& graph );
+  void read( istream& in, const string& source_name );
+  void set_arcs( vector<vector<Arc> >& up_arcs,
+		 vector<vector<Arc> >& down_arcs );
+  void init_queries();
+  int find_up( int i, int j ) const;
+  int find_down( int i, int j ) const;
+  void unpack( int i, int j, int middle, vector<int>& path ) const;
+
+  // (not copyable)
+  ContractionHierarchy( const ContractionHierarchy& );
+  ContractionHierarchy& operator=( const ContractionHierarchy& );
+};
+
+#endif
@@ -12,9 +12,14 @@
 #include <string>
 #include <iostream>
 #include <sstream>
-#include <fstream>
+#include <cstring>
+#include <new>
+#include <map>
+#include <algorithm>
 
 #include "Graph.h"
+#include "GraphParser.h"
+#include "Subgraph.h"
 
 #ifdef GRAPHICAL
 #include "PDFGraph.h"
@@ -31,12 +36,14 @@ bool Verbose = false;
  * joining node 'a' to node 'b', nodes 'b' is said to be "adjacent"
  * to 'a'.
  *
- * In this implementation, the nodes are represented by an array of
- * 'GraphNode' instances; the edges or arcs, as an adjacency matrix.
- * If the graph nodes are numbered 0, 1, ..., n - 1 ('n' is the number
- * of nodes), the adjacency matrix is represented by a two-dimensional
- * 'n'-by-'n' array named 'adjacency'.  The value of 'adjacency[i][j]'
- * is 1 if, and only if, node 'j' is adjacent to node 'i'.
+ * In this implementation, the nodes are represented by parallel arrays
+ * of their fields (one each for the states, flags, values, and names).
+ * The edges or arcs are best pictured as an adjacency matrix: if the
+ * graph nodes are numbered 0, 1, ..., n - 1 ('n' is the number of
+ * nodes), it is an 'n'-by-'n' matrix 'adj' in which the value of
+ * 'adj[i][j]' is 1 if, and only if, node 'j' is adjacent to node 'i'.
+ * (The matrix itself is not stored; see "Storage" below for the arrays
+ * that hold its nonzero cells.)
  *
  * Here is an example:
  *
@@ -89,6 +96,61 @@ bool Verbose = false;
  *
  * For this implementation, we assume that the arc weights are all positive,
  * and the default weight is 1.
+ *
+ * Storage
+ * -------
+ *
+ * The adjacency matrix is how the graph is best thought of, but storing
+ * it takes n*n cells no matter how few arcs there are, and scanning a row
+ * for the neighbors of a node takes O(n) time.  So the matrix is actually
+ * stored in "compressed sparse row" (CSR) form: only the nonzero cells of
+ * each row are kept, packed one row after another into three arrays
+ *
+ *   arc_offsets[i]   index of the first arc of row 'i' (size n + 1)
+ *   arc_targets[a]   column (end node) of arc 'a'      (size m)
+ *   arc_weights[a]   value (weight) of arc 'a'         (size m)
+ *
+ * so the arcs leaving node 'i' are arc_offsets[i] .. arc_offsets[i+1] - 1.
+ * For the weighted example above this is
+ *
+ *   arc_offsets   0   1   2   3   6   8
+ *   arc_targets   1   2   4   0   1   2   2   3
+ *   arc_weights  0.1 0.7 0.6 0.1 0.9 0.8 0.2 0.5
+ *
+ * The targets within each row are kept sorted, so 'adj[i][j]' is found by
+ * a binary search of row 'i'.  Memory is O(n + m) and visiting all the
+ * neighbors of every node takes O(n + m) time.
+ *
+ * Packed rows make adding an arc expensive, since every arc after it has
+ * to move.  So a row need not fill its places: the arcs of row 'i' are
+ * arc_offsets[i] .. arc_ends[i] - 1, and the places after them, up to
+ * the start of the next row, are room for more.  A graph is read with
+ * its rows packed (arc_ends[i] is arc_offsets[i+1]), and the first arc
+ * added to a row with no room lays the rows out again with room for a
+ * quarter more arcs each (see 'layout_arcs').  After that an arc is added
+ * by moving the arcs after it in its row, and if the row is full, moving
+ * the nearest rows over by one place to give it the room of a neighbor
+ * (see 'borrow_room'); only when there is no room nearby are the rows
+ * laid out again.  Removing an arc moves the rest of its row down,
+ * leaving room, and if removals leave more room than arcs, the rows are
+ * laid out again to give it back.  So adding and removing arcs takes
+ * time proportional to the row, plus an occasional O(n + m) layout,
+ * rather than O(n + m) each time.  The rows stay in order, and 'adj[i][j]'
+ * is still a binary search of row 'i'.  'compact_arcs' packs the rows
+ * once a graph stops changing.
+ *
+ * The arc arrays and the node arrays are carved out of one block of
+ * memory, each starting on a 64-byte cache line (see 'allocate_arrays').
+ * So a graph takes one allocation and one free, however many arrays it
+ * has, and copying a packed graph is one 'memcpy' of the block.  Laying
+ * out the rows again moves all the arrays to a new block.
+ *
+ * An unweighted graph only needs one bit per cell, and when it is dense
+ * enough the full matrix at one bit per cell is smaller than the CSR
+ * arrays.  Such graphs can keep a bit matrix alongside the CSR arrays
+ * (see 'update_bit_matrix'), which answers 'adj[i][j]' with one bit test
+ * and lets breadth-first search handle 64 nodes per word operation.  The
+ * CSR arrays remain the primary storage.
  */
 
 
@@ -99,54 +161,120 @@ bool Verbose = false;
 Graph::Graph(const string& filename)
 // Constructs this graph by reading from 'filename'
 {
-	// Instantiate an 'ifstream' (an 'istream' subclass that reads from a file)
-	ifstream in;
-	in.open(filename.c_str());
-	if (!in) {
+	// Map the file into memory (or read it in, where it can't be mapped)
+	MappedFile file(filename);
+	if (!file.is_open()) {
 		// Just crash if the file can't be opened
 		cerr << "Can't read from " << filename << ".  Exiting.\n";
 		exit(1);
 	}
 
-	// call the 'read' function, which works on a general 'istream'
-	read(in, filename);
+	// parse it with the fast reader for the same format as 'read', or
+	// import it, if it is in one of the other formats the reader knows
+	// (see "GraphParser.h")
+	GraphParser parser(file.begin(), file.end(), filename);
+	GraphParser::Format format = GraphParser::detect_format(filename,
+		file.begin(), file.end());
+	if (format == GraphParser::GraphText)
+		parser.read(*this);
+	else
+		parser.import(*this, format);
+}
+
+Graph::Graph(const string& filename, ThreadPool& pool)
+// Constructs this graph by reading from 'filename', parsing the arcs
+// on the threads of 'pool'
+{
+	MappedFile file(filename);
+	if (!file.is_open()) {
+		cerr << "Can't read from " << filename << ".  Exiting.\n";
+		exit(1);
+	}
 
-	// close the 'ifstream'
-	in.close();
+	// (the importers only read on one thread)
+	GraphParser parser(file.begin(), file.end(), filename);
+	GraphParser::Format format = GraphParser::detect_format(filename,
+		file.begin(), file.end());
+	if (format == GraphParser::GraphText)
+		parser.read(*this, pool);
+	else
+		parser.import(*this, format);
 }
 
 
 
 Graph::Graph(const Graph& src)
 // Copy constructor
+	: Graph(src, true)
+{
+}
+
+Graph::Graph(const Graph& src, bool with_arcs)
+// Copies the nodes of 'src' (and their drawing data), and its arcs only
+// if 'with_arcs' is true
 {
 	n = src.n;
-	init(n);
-	for (int k = 0; k < n; k++)
-		nodes[k] = src.nodes[k];
-	for (int i = 0; i < n; i++) {
-		for (int j = 0; j < n; j++) {
-			adj[i][j] = src.adj[i][j];
-		}
+	init(n, (with_arcs ? src.m : 0));
+	if (with_arcs && src.arc_capacity == src.m && !src.snapshot
+		&& src.arena_size == arena_size) {
+		// the blocks are laid out the same, so one copy does it
+		memcpy(arena, src.arena, arena_size);
+		m = src.m;
 	}
-
-	weighted = src.weighted;
+	else {
+		copy_arrays(src, with_arcs);
+	}
+	name_chars = src.name_chars;
+	name_offsets = src.name_offsets;
+	weighted = (with_arcs && src.weighted);
 	directed = src.directed;
 
 #ifdef GRAPHICAL
 	scale = src.scale;
-	for (int k = 0; k < n; k++)
-		node_pos[k] = src.node_pos[k];
-	for (int i = 0; i < n; i++) {
-		for (int j = 0; j < n; j++) {
-			arc_pos[i][j] = src.arc_pos[i][j];
-		}
-	}
+	arc_points = src.arc_points;
 
 	// just copy the pointer to the 'pdf' object
 	pdf = src.pdf;
 #endif
+}
+
+void Graph::copy_arrays(const Graph& src, bool with_arcs)
+// Copies the node arrays of 'src', one at a time, and its arcs (packing
+// the rows) if 'with_arcs' is true.  This has places for them.
+{
+	src.clear_stale_fields();
+	memcpy(node_states, src.node_states, n*sizeof(unsigned char));
+	memcpy(node_flags, src.node_flags, n*sizeof(unsigned));
+	memcpy(node_values, src.node_values, n*sizeof(double));
+	memcpy(node_names, src.node_names, n*sizeof(int));
+#ifdef GRAPHICAL
+	memcpy(node_pos, src.node_pos, n*sizeof(PDFPoint));
+#endif
+
+	if (!with_arcs)
+		return;
 
+	// copy the arc arrays, packing the rows
+	m = src.m;
+	if (src.arc_capacity == src.m) {
+		memcpy(arc_offsets, src.arc_offsets, (n + 1)*sizeof(int));
+		memcpy(arc_targets, src.arc_targets, m*sizeof(int));
+		memcpy(arc_weights, src.arc_weights, m*sizeof(double));
+	}
+	else {
+		int a = 0;
+		for (int i = 0; i < n; i++) {
+			int degree = src.out_degree(i);
+			arc_offsets[i] = a;
+			memcpy(arc_targets + a, src.arc_targets + src.arc_offsets[i],
+				degree*sizeof(int));
+			memcpy(arc_weights + a, src.arc_weights + src.arc_offsets[i],
+				degree*sizeof(double));
+			a += degree;
+		}
+		arc_offsets[n] = m;
+	}
+	set_row_ends();
 }
 
 
@@ -267,10 +395,18 @@ void Graph::read(istream& in, const string& source_name)
 	int n_nodes;
 	in >> n_nodes;
 
-	// Allocates the array of nodes and the adjacency matrix,
+	// Allocates the array of nodes and the (empty) arc arrays,
 	// assuming there are exactly 'n_nodes' nodes
 	init(n_nodes);
 
+	// The arcs are collected as they are read, and packed into the
+	// arc arrays all at once at the end
+	vector<ArcRecord> arcs;
+
+	// The index of each distinct node name
+	map<string, int> name_index;
+	name_index[""] = 0;
+
 	/* The rest of the input is a sequence of lines.  Blank lines and
 	 * lines that start with a "#" character (comment lines) are ignored.
 	 * Other lines must have the form
@@ -284,7 +420,7 @@ void Graph::read(istream& in, const string& source_name)
 	 * loop.
 	 *
 	 * NOTE: values that index nodes use indexing starting from 1; however,
-	 *       the 'nodes' and 'adj' array have indexing starting from 0
+	 *       the node and arc arrays have indexing starting from 0
 	 *       as usual.
 	 */
 
@@ -326,11 +462,15 @@ void Graph::read(istream& in, const string& source_name)
 			}
 			// get the string argument
 			string node_name = get_string(in);
-			nodes[node_count].name = node_name;
-			nodes[node_count].index = node_count + 1;
-			nodes[node_count].value = 0;
-			nodes[node_count].state = 0;
-			nodes[node_count].flags = 0;
+			map<string, int>::iterator named = name_index.find(node_name);
+			if (named == name_index.end()) {
+				named = name_index.insert(make_pair(node_name,
+					add_name(node_name))).first;
+			}
+			node_names[node_count] = named->second;
+			node_values[node_count] = 0;
+			node_states[node_count] = 0;
+			node_flags[node_count] = 0;
 			node_count++;
 			if (Verbose)
 				cout << "read node '" << node_name << "'\n";
@@ -352,7 +492,8 @@ void Graph::read(istream& in, const string& source_name)
 			if (!check_arc_indices(start, end, n_nodes, source_name, line_num))
 				exit(1);
 
-			adj[start - 1][end - 1] = 1;
+			ArcRecord arc = { start - 1, end - 1, 1 };
+			arcs.push_back(arc);
 			if (Verbose)
 				cout << "read arc from " << start << " to " << end << endl;
 		}
@@ -378,7 +519,8 @@ void Graph::read(istream& in, const string& source_name)
 				exit(1);
 			}
 
-			adj[start - 1][end - 1] = weight;
+			ArcRecord arc = { start - 1, end - 1, weight };
+			arcs.push_back(arc);
 			// set the 'weighted' flag to true
 			weighted = true;
 
@@ -401,7 +543,7 @@ void Graph::read(istream& in, const string& source_name)
 			in >> index >> value;
 			if (!check_node_index(index, n_nodes, source_name, line_num))
 				exit(1);
-			nodes[index - 1].value = value;
+			node_values[index - 1] = value;
 			if (Verbose)
 				cout << "read node value " << index << " valued at " << value << endl;
 		}
@@ -425,6 +567,7 @@ void Graph::read(istream& in, const string& source_name)
 			if (!check_node_index(index, n_nodes, source_name, line_num))
 				exit(1);
 			node_pos[index - 1] = PDFPoint(x, y);
+			astar_ratio = -1;
 			if (Verbose)
 				cout << "read node position " << index
 				<< ", ( " << x << ", " << y << ")" << endl;
@@ -444,7 +587,7 @@ void Graph::read(istream& in, const string& source_name)
 			in >> start >> end >> x >> y;
 			if (!check_arc_indices(start, end, n_nodes, source_name, line_num))
 				exit(1);
-			arc_pos[start - 1][end - 1] = new PDFPoint(x, y);
+			set_arc_point(start - 1, end - 1, PDFPoint(x, y));
 			if (Verbose)
 				cout << "read arc point " << start << ", " << end
 				<< ", ( " << x << ", " << y << ")" << endl;
@@ -469,6 +612,11 @@ void Graph::read(istream& in, const string& source_name)
 
 #endif
 
+		else if (key == "q") {
+			/* A "q" line ends the input (the loop stops on it)
+			 */
+		}
+
 		else {
 			/* Lines beginning with unknown keys are ignored.
 			 * Send message to cerr and close stdIn
@@ -478,6 +626,9 @@ void Graph::read(istream& in, const string& source_name)
 		}
 	}
 
+	// Pack the arcs into the arc arrays
+	build_arcs(arcs);
+
 	// That's it.
 	// Input file errors causes immediate failure and program exit, so there
 	// is no need to return anything--if it returns, the input file was okay.
@@ -488,27 +639,48 @@ void Graph::read(istream& in, const string& source_name)
 /* Initialization */
 /******************/
 
-void Graph::init(int n_nodes)
-// Allocates the array of nodes and the adjacency matrix
+void Graph::init(int n_nodes, int arc_places)
+// Allocates the node arrays and the arc arrays, with places
+// for 'arc_places' arcs (but no arcs yet)
 // If the graphical output is active, this also initializes the
 // extra graphical data
 {
 	// Set 'n' to the number of nodes
 	n = n_nodes;
 
-	// Allocate the 'nodes' array; at this point the individual nodes
-	// are not set; they are added as the nodes are input.
-	nodes = new GraphNode[n];  // (this calls the default constructor)
-
-	// Allocate the adjacency matrix, and initialize the elements
-	// to zero.  The adjacencies are added as the arcs are input.
-	adj = new double*[n];
-	for (int i = 0; i < n; i++) {
-		adj[i] = new double[n];
-		for (int j = 0; j < n; j++) {
-			adj[i][j] = 0;
-		}
-	}
+	// Carve all the arrays out of one block
+	arena = NULL;
+	allocate_arrays(arc_places);
+
+	// Set up the node arrays; every node starts out unnamed, with
+	// zero state, flags, and value.  The names are added as the nodes
+	// are input.
+	memset(node_states, 0, n*sizeof(unsigned char));
+	memset(node_flags, 0, n*sizeof(unsigned));
+	memset(node_names, 0, n*sizeof(int));
+	fill(node_values, node_values + n, 0.0);
+	name_chars.clear();
+	name_offsets.assign(2, 0);
+
+	// Set up the arc arrays with no arcs; every row starts out empty.
+	// The arcs are added as they are input.
+	m = 0;
+	arc_capacity = arc_places;
+	for (int i = 0; i < n; i++)
+		arc_offsets[i] = 0;
+	arc_offsets[n] = arc_capacity;
+	for (int i = 0; i < n; i++)
+		arc_ends[i] = 0;
+
+	// The incoming index is built when it is first needed
+	in_valid = false;
+	in_offsets = in_sources = in_arcs = NULL;
+	bits_valid = false;
+	bit_words = 0;
+	bit_rows = NULL;
+	astar_ratio = -1;
+	snapshot = NULL;
+	fields_stale = false;
 
 	// Assume the arcs as unweighted and it's a directed graph
 	weighted = false;
@@ -519,31 +691,162 @@ void Graph::init(int n_nodes)
 	// Set the default scale to 72 (points)
 	scale = 72;
 
-	// Allocate the node positions array
-	node_pos = new PDFPoint[n];
+	// Every node starts at the origin
+	for (int i = 0; i < n; i++)
+		node_pos[i] = PDFPoint(0, 0);
 
-	// The arc points, if specified, are stored in a matrix in the
-	// same format as the adjacency matrix.  Entries in the arc
-	// point matrix are pointers to PDFPoint objects.
-	arc_pos = new PDFPoint**[n];
-	for (int i = 0; i < n; i++) {
-		arc_pos[i] = new PDFPoint*[n];
-		for (int j = 0; j < n; j++) {
-			arc_pos[i][j] = NULL;
-		}
-	}
+	// The arc points, if specified, are added to 'arc_points' as they
+	// are input
+	arc_points.clear();
 
 	pdf = NULL; // set the PDF object to null
 #endif
 }
 
+int Graph::add_name(string_view name)
+// Appends 'name' to the node names, and returns its index
+{
+	name_chars.insert(name_chars.end(), name.begin(), name.end());
+	name_offsets.push_back(name_chars.size());
+	return name_count() - 1;
+}
+
+
+/*********/
+/* Arena */
+/*********/
+
+// The node and arc arrays of a graph are carved out of one block of
+// memory (the "arena"), in this order, each starting on a 64-byte cache
+// line.  The arc arrays come last, so the node arrays are at the same
+// places in every block for the same number of nodes.
+enum {
+	ArenaStates, ArenaFlags, ArenaValues, ArenaNames, ArenaPositions,
+	ArenaOffsets, ArenaEnds, ArenaTargets, ArenaWeights, ArenaArrays
+};
+
+static size_t arena_layout(int n, int capacity, size_t start[ArenaArrays])
+// Sets 'start' to where each array starts in the block for 'n' nodes
+// and 'capacity' arcs, and returns the size of the block
+{
+	size_t bytes[ArenaArrays];
+	bytes[ArenaStates] = (size_t)n*sizeof(unsigned char);
+	bytes[ArenaFlags] = (size_t)n*sizeof(unsigned);
+	bytes[ArenaValues] = (size_t)n*sizeof(double);
+	bytes[ArenaNames] = (size_t)n*sizeof(int);
+#ifdef GRAPHICAL
+	bytes[ArenaPositions] = (size_t)n*sizeof(PDFPoint);
+#else
+	bytes[ArenaPositions] = 0;
+#endif
+	bytes[ArenaOffsets] = (size_t)(n + 1)*sizeof(int);
+	bytes[ArenaEnds] = (size_t)n*sizeof(int);
+	bytes[ArenaTargets] = (size_t)capacity*sizeof(int);
+	bytes[ArenaWeights] = (size_t)capacity*sizeof(double);
+
+	size_t offset = 0;
+	for (int k = 0; k < ArenaArrays; k++) {
+		start[k] = offset;
+		offset += (bytes[k] + 63) & ~(size_t)63;
+	}
+	return offset;
+}
+
+void Graph::allocate_arrays(int capacity)
+// Allocates a block for the node arrays and 'capacity' arcs, and points
+// the arrays into it (the contents are left undefined).  The previous
+// block, if there is one, is freed.
+{
+	size_t start[ArenaArrays];
+	size_t size = arena_layout(n, capacity, start);
+	char *block = (char *)operator new[](size, align_val_t(64));
+	free_arena(arena);
+	arena = block;
+	arena_size = size;
+
+	node_states = (unsigned char *)(block + start[ArenaStates]);
+	node_flags = (unsigned *)(block + start[ArenaFlags]);
+	node_values = (double *)(block + start[ArenaValues]);
+	node_names = (int *)(block + start[ArenaNames]);
+#ifdef GRAPHICAL
+	node_pos = (PDFPoint *)(block + start[ArenaPositions]);
+#endif
+	arc_offsets = (int *)(block + start[ArenaOffsets]);
+	arc_ends = (int *)(block + start[ArenaEnds]);
+	arc_targets = (int *)(block + start[ArenaTargets]);
+	arc_weights = (double *)(block + start[ArenaWeights]);
+}
+
+char *Graph::move_arrays(int capacity)
+// Moves the arrays to a new block with places for 'capacity' arcs.  The
+// node arrays, the arc offsets, and the arc ends are copied; the arcs are
+// not.  Returns the old block (which the old 'arc_targets' and
+// 'arc_weights' may still point into) for the caller to free with
+// 'free_arena' once it is done with them.
+{
+	clear_stale_fields();
+	unsigned char *states = node_states;
+	unsigned *flags = node_flags;
+	double *values = node_values;
+	int *names = node_names;
+	int *offsets = arc_offsets;
+	int *ends = arc_ends;
+#ifdef GRAPHICAL
+	PDFPoint *pos = node_pos;
+#endif
+
+	char *old = arena;
+	arena = NULL;
+	allocate_arrays(capacity);
+	memcpy(node_states, states, n*sizeof(unsigned char));
+	memcpy(node_flags, flags, n*sizeof(unsigned));
+	memcpy(node_values, values, n*sizeof(double));
+	memcpy(node_names, names, n*sizeof(int));
+#ifdef GRAPHICAL
+	memcpy(node_pos, pos, n*sizeof(PDFPoint));
+#endif
+	memcpy(arc_offsets, offsets, (n + 1)*sizeof(int));
+	memcpy(arc_ends, ends, n*sizeof(int));
+	return old;
+}
+
+void Graph::free_arena(char *block)
+// Frees a block from 'allocate_arrays' (or does nothing, if it's NULL)
+{
+	if (block)
+		operator delete[](block, align_val_t(64));
+}
+
 /**********/
 /* Output */
 /**********/
 
-ostream& Graph::write(ostream& out, bool brief, const string &prefix)
+ostream& Graph::write(ostream& out, bool brief, const string &prefix) const
 // Writes a text representation of this graph, in the format
 // described in the 'read' function above.  
+{
+	write_nodes(out, brief, prefix);
+
+	// write the arcs
+	for (int i = 0; i < n; i++) {
+		for (int a = arc_offsets[i]; a < arc_ends[i]; a++) {
+			int j = arc_targets[a];
+			if (weighted)
+				out << prefix << "weighted_arc " << (i + 1) << " " << (j + 1)
+				<< " " << arc_weights[a] << "\n";
+			else
+				out << prefix << "arc " << (i + 1) << " " << (j + 1) << "\n";
+		}
+	}
+
+	if (!brief)
+		write_layout(out, prefix);
+	return out;
+}
+
+void Graph::write_nodes(ostream& out, bool brief, const string &prefix) const
+// Writes the part of the text representation (see 'write') that comes
+// before the arcs: the header and the nodes
 {
 	// write the "magic number"
 	// NOTE: This has to use "\n" (not 'endl')
@@ -555,50 +858,38 @@ ostream& Graph::write(ostream& out, bool brief, const string &prefix)
 	// write the nodes
 	if (!brief) {
 		for (int i = 0; i < n; i++)
-			out << prefix << "node \"" << nodes[i].name << "\"\n";
+			out << prefix << "node \"" << node_name(i) << "\"\n";
 	}
 
 	// write the node values (if there are any)
 	for (int i = 0; i < n; i++)
-		if (nodes[i].value != 0)
+		if (node_values[i] != 0)
 			out << prefix << "node_value " << (i + 1) << " "
-			<< nodes[i].value << "\n";
+			<< node_values[i] << "\n";
 
 	// write the node states (if there are any)
+	clear_stale_fields();
 	for (int i = 0; i < n; i++)
-		if (nodes[i].state != 0)
+		if (node_states[i] != 0)
 			out << prefix << "node_state " << (i + 1) << " "
-			<< nodes[i].value << "\n";
-
-	// write the arcs
-	for (int i = 0; i < n; i++) {
-		for (int j = 0; j < n; j++) {
-			if (adj[i][j] > 0) {
-				if (weighted)
-					out << prefix << "weighted_arc " << (i + 1) << " " << (j + 1)
-					<< " " << adj[i][j] << "\n";
-				else
-					out << prefix << "arc " << i << " " << (j + 1) << "\n";
-			}
-		}
-	}
+			<< node_values[i] << "\n";
+}
 
+void Graph::write_layout(ostream& out, const string &prefix) const
+// Writes the part of the text representation (see 'write') that comes
+// after the arcs: the node positions and arc points (if there are any)
+{
 #ifdef GRAPHICAL
-	if (!brief) {
-		// write the node positions
-		for (int i = 0; i < n; i++)
-			out << prefix << "node_pos " << (i + 1) << " "
-			<< node_pos[i].x << " " << node_pos[i].y << "\n";
-		// write the arc positions
-		for (int i = 0; i < n; i++)
-			for (int j = 0; j < n; j++)
-				if (arc_pos[i][j])
-					out << prefix << "arc_point " << (i + 1) << " " << (j + 1) << " "
-					<< arc_pos[i][j]->x << " " << arc_pos[i][j]->y << "\n";
-	}
+	// write the node positions
+	for (int i = 0; i < n; i++)
+		out << prefix << "node_pos " << (i + 1) << " "
+		<< node_pos[i].x << " " << node_pos[i].y << "\n";
+	// write the arc positions
+	for (size_t k = 0; k < arc_points.size(); k++)
+		out << prefix << "arc_point " << (arc_points[k].start + 1) << " "
+		<< (arc_points[k].end + 1) << " "
+		<< arc_points[k].p.x << " " << arc_points[k].p.y << "\n";
 #endif
-
-	return out;
 }
 
 /********************/
@@ -638,15 +929,18 @@ bool Graph::adjacent(int i, int j) const
 	if (!check_index(j, n, "adjacent() (end index)"))
 		return false;
 
-	// check the adjacency matrix
-	return (adj[i][j] > 0);
+	// test bit 'j' of row 'i', or look for 'j' in row 'i'
+	if (bits_valid)
+		return (bit_row(i)[j >> 6] >> (j & 63)) & 1;
+	return (find_arc(i, j) >= 0);
 }
 
 double Graph::get_arc_weight(int i, int j) const
 // Returns the weight of the arc from node 'i' to node 'j'
 // or 0 if there is no arc, or the indices are out of range
-// The result is the actual weight stored in the 'adj' matrix
-// so this is independent of the state of the 'weighted' field.
+// The result is the actual weight stored in the arc arrays (the
+// value of 'adj[i][j]'; see "Storage" above), so this is independent
+// of the state of the 'weighted' field.
 // (The indexing starts at 0)
 {
 	// check the indices
@@ -655,9 +949,9 @@ double Graph::get_arc_weight(int i, int j) const
 	if (!check_index(j, n, "get_arc_weight() (end index)"))
 		return 0;
 
-	// in this implementation, the adjacency matrix elements store the
-	// weight of the arcs directly
-	return adj[i][j];
+	// the arc arrays store the weight of the arcs directly
+	int a = find_arc(i, j);
+	return (a >= 0 ? arc_weights[a] : 0);
 }
 
 GraphNode Graph::get_node(int i) const
@@ -666,9 +960,11 @@ GraphNode Graph::get_node(int i) const
 {
 	// check the index
 	if (!check_index(i, n, "get_node()"))
-		return nodes[0]; // wrong, of course
+		return GraphNode(); // wrong, of course
 
-	return nodes[i];
+	clear_stale_fields();
+	return GraphNode(string(node_name(i)), i + 1, node_states[i], node_values[i],
+		node_flags[i]);
 }
 
 int Graph::get_node_state(int i) const
@@ -679,7 +975,8 @@ int Graph::get_node_state(int i) const
 	if (!check_index(i, n, "get_node_state()"))
 		return 0;
 
-	return nodes[i].state;
+	clear_stale_fields();
+	return node_states[i];
 }
 
 double Graph::get_node_value(int i) const
@@ -690,7 +987,7 @@ double Graph::get_node_value(int i) const
 	if (!check_index(i, n, "get_node_value()"))
 		return 0;
 
-	return nodes[i].value;
+	return node_values[i];
 }
 
 unsigned Graph::get_node_flags(int i) const
@@ -701,7 +998,8 @@ unsigned Graph::get_node_flags(int i) const
 	if (!check_index(i, n, "get_node_flags()"))
 		return 0;
 
-	return nodes[i].flags;
+	clear_stale_fields();
+	return node_flags[i];
 }
 
 
@@ -725,9 +1023,14 @@ void Graph::set_arc_weight(int i, int j, double weight)
 		weight = 1;
 	}
 
-	// in this implementation, the adjacency matrix elements store the
-	// weight of the arcs directly
-	adj[i][j] = weight;
+	// the arc arrays store the weight of the arcs directly;
+	// setting the weight of a missing arc adds the arc
+	int a = find_arc(i, j);
+	if (a >= 0)
+		arc_weights[a] = weight;
+	else
+		insert_arc(i, j, weight);
+	astar_ratio = -1;
 }
 
 void Graph::set_all_arc_weights(double weight)
@@ -735,9 +1038,9 @@ void Graph::set_all_arc_weights(double weight)
 // defaults to 1) 
 {
 	for (int i = 0; i < n; i++)
-		for (int j = 0; j < n; j++)
-			if (adj[i][j] > 0)
-				adj[i][j] = weight;
+		for (int a = arc_offsets[i]; a < arc_ends[i]; a++)
+			arc_weights[a] = weight;
+	astar_ratio = -1;
 }
 
 
@@ -751,12 +1054,12 @@ bool Graph::remove_arc(int i, int j)
 	if (!check_index(j, n, "remove_arc() (end index)"))
 		return false;
 
-	if (adj[i][j] > 0) {
-		adj[i][j] = 0;
+	int a = find_arc(i, j);
+	if (a >= 0) {
+		erase_arcs(i, a, a + 1);
 		return true;
 	}
 	else {
-		adj[i][j] = 0;
 		return false;
 	}
 }
@@ -764,10 +1067,14 @@ bool Graph::remove_arc(int i, int j)
 void Graph::remove_all_arcs()
 // Removes all the arcs in this graph
 {
-	// Setting all the 'adj' cells to 0 sufficies
+	// Emptying every row sufficies (the arrays are kept for reuse, as
+	// room for the last row)
+	own_arrays();
 	for (int i = 0; i < n; i++)
-		for (int j = 0; j < n; j++)
-			adj[i][j] = 0;
+		arc_offsets[i] = arc_ends[i] = 0;
+	m = 0;
+	in_valid = false;
+	bits_valid = false;
 }
 
 void Graph::remove_outgoing_arcs(int i)
@@ -775,9 +1082,8 @@ void Graph::remove_outgoing_arcs(int i)
 {
 	if (!check_index(i, n, "remove_outgoing_arcs()"))
 		return;
-	// this amounts to setting row 'i' in the adjacency matrix to all zeros
-	for (int j = 0; j < n; j++)
-		adj[i][j] = 0;
+	// this amounts to emptying row 'i'
+	erase_arcs(i, arc_offsets[i], arc_ends[i]);
 }
 
 void Graph::remove_incoming_arcs(int j)
@@ -785,9 +1091,12 @@ void Graph::remove_incoming_arcs(int j)
 {
 	if (!check_index(j, n, "remove_incoming_arcs()"))
 		return;
-	// this amounts to setting column 'j' in the adjacency matrix to all zeros
-	for (int i = 0; i < n; i++)
-		adj[i][j] = 0;
+	// this amounts to removing column 'j' from every row
+	for (int i = 0; i < n; i++) {
+		int a = find_arc(i, j);
+		if (a >= 0)
+			erase_arcs(i, a, a + 1);
+	}
 }
 
 void Graph::unweight_arcs()
@@ -809,12 +1118,14 @@ bool Graph::add_arc(int i, int j)
 	if (!check_index(j, n, "add_arc() (end index)"))
 		return false;
 
-	if (adj[i][j] > 0) {
-		adj[i][j] = 1;
+	int a = find_arc(i, j);
+	if (a >= 0) {
+		arc_weights[a] = 1;
+		astar_ratio = -1;
 		return true;
 	}
 	else {
-		adj[i][j] = 1;
+		insert_arc(i, j, 1);
 		return false;
 	}
 }
@@ -835,14 +1146,303 @@ bool Graph::add_arc(int i, int j, double weight)
 		weight = 1;
 	}
 
-	if (adj[i][j] > 0) {
-		adj[i][j] = weight;
+	int a = find_arc(i, j);
+	if (a >= 0) {
+		arc_weights[a] = weight;
+		astar_ratio = -1;
 		return true;
 	}
 	else {
-		adj[i][j] = weight;
+		insert_arc(i, j, weight);
+		return false;
+	}
+}
+
+
+/* Arc Storage */
+
+void Graph::build_arcs(vector<ArcRecord>& arcs)
+// Replaces all the arcs of this graph with those in 'arcs', which
+// are sorted in place.  If an arc appears more than once, the last
+// one wins (as if each had been assigned to 'adj[i][j]' in order).
+{
+	own_arrays();
+	stable_sort(arcs.begin(), arcs.end());
+
+	// drop all but the last of each run of duplicates
+	size_t count = 0;
+	for (size_t k = 0; k < arcs.size(); k++) {
+		if (k + 1 < arcs.size() && arcs[k + 1].start == arcs[k].start
+			&& arcs[k + 1].end == arcs[k].end)
+			continue;
+		arcs[count++] = arcs[k];
+	}
+	arcs.resize(count);
+
+	// (the old arcs aren't needed)
+	free_arena(move_arrays((int)count));
+	m = arc_capacity = (int)count;
+
+	// fill the rows in order, recording where each one starts
+	int k = 0;
+	for (int i = 0; i < n; i++) {
+		arc_offsets[i] = k;
+		while (k < m && arcs[k].start == i) {
+			arc_targets[k] = arcs[k].end;
+			arc_weights[k] = arcs[k].weight;
+			k++;
+		}
+	}
+	arc_offsets[n] = m;
+	set_row_ends();
+	in_valid = false;
+	bits_valid = false;
+	astar_ratio = -1;
+}
+
+void Graph::set_row_ends()
+// Sets the end of each row to the start of the next, for arcs packed one
+// row after another
+{
+	for (int i = 0; i < n; i++)
+		arc_ends[i] = arc_offsets[i + 1];
+}
+
+int Graph::find_arc(int i, int j) const
+// Returns the index of the arc i->j in the arc arrays, or -1 if there
+// is no such arc.  (The indices are not checked.)
+{
+	const int *first = arc_targets + arc_offsets[i];
+	const int *last = arc_targets + arc_ends[i];
+	const int *p = lower_bound(first, last, j);
+	return (p != last && *p == j ? (int)(p - arc_targets) : -1);
+}
+
+void Graph::insert_arc(int i, int j, double weight)
+// Inserts the arc i->j, which must not already exist, keeping row 'i'
+// sorted.  This moves the arcs after it in the row into the room after
+// the row, which is made first if there isn't any.
+{
+	if (arc_ends[i] == arc_offsets[i + 1] && !borrow_room(i))
+		layout_arcs(true);
+
+	const int *first = arc_targets + arc_offsets[i];
+	const int *last = arc_targets + arc_ends[i];
+	int a = (int)(lower_bound(first, last, j) - arc_targets);
+
+	int count = arc_ends[i] - a;
+	memmove(arc_targets + a + 1, arc_targets + a, count*sizeof(int));
+	memmove(arc_weights + a + 1, arc_weights + a, count*sizeof(double));
+	arc_targets[a] = j;
+	arc_weights[a] = weight;
+	arc_ends[i]++;
+	m++;
+	in_valid = false;
+	bits_valid = false;
+	astar_ratio = -1;
+}
+
+// The most rows, and arcs (of rows other than the one that needs it),
+// that 'borrow_room' will move to make room for an arc
+static const int MaxBorrowRows = 64;
+static const int MaxBorrowArcs = 1024;
+
+bool Graph::borrow_room(int i)
+// Makes room for one more arc at the end of row 'i', which is full, by
+// moving the rows between it and the nearest row with room to spare
+// over by one place.  Returns false if that row is too far away.
+{
+	// look for room after the rows that follow
+	for (int r = i + 1; r < n && r - i <= MaxBorrowRows; r++) {
+		if (arc_ends[r] - arc_offsets[i + 1] > MaxBorrowArcs)
+			break;
+		if (arc_ends[r] < arc_offsets[r + 1]) {
+			// move rows i+1..r up one place, into the room after row 'r'
+			int first = arc_offsets[i + 1];
+			int count = arc_ends[r] - first;
+			memmove(arc_targets + first + 1, arc_targets + first,
+				count*sizeof(int));
+			memmove(arc_weights + first + 1, arc_weights + first,
+				count*sizeof(double));
+			for (int k = i + 1; k <= r; k++) {
+				arc_offsets[k]++;
+				arc_ends[k]++;
+			}
+			return true;
+		}
+	}
+
+	// look for room after the rows before
+	for (int l = i - 1; l >= 0 && i - l <= MaxBorrowRows; l--) {
+		if (arc_offsets[i] - arc_ends[l] > MaxBorrowArcs)
+			break;
+		if (arc_ends[l] < arc_offsets[l + 1]) {
+			// move rows l+1..i down one place, into the room after row 'l'
+			int first = arc_offsets[l + 1];
+			int count = arc_ends[i] - first;
+			memmove(arc_targets + first - 1, arc_targets + first,
+				count*sizeof(int));
+			memmove(arc_weights + first - 1, arc_weights + first,
+				count*sizeof(double));
+			for (int k = l + 1; k <= i; k++) {
+				arc_offsets[k]--;
+				arc_ends[k]--;
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+void Graph::erase_arcs(int i, int first, int last)
+// Removes the arcs with indices 'first'..'last - 1', which must all
+// be in row 'i'.  The rest of the row moves down, leaving more room
+// after it.
+{
+	int count = last - first;
+	if (count <= 0)
+		return;
+
+	own_arrays();
+	int rest = arc_ends[i] - last;
+	memmove(arc_targets + first, arc_targets + last, rest*sizeof(int));
+	memmove(arc_weights + first, arc_weights + last, rest*sizeof(double));
+	arc_ends[i] -= count;
+	m -= count;
+	in_valid = false;
+	bits_valid = false;
+
+	// give back the room, once it's more than the arcs need
+	if (arc_capacity > 2*(m + n) + 64)
+		layout_arcs(true);
+}
+
+void Graph::layout_arcs(bool with_room)
+// Copies the arcs to new arrays (in a new arena), one row after another,
+// leaving room after each row for a quarter more arcs (and one more) if
+// 'with_room' is true, and none otherwise.  If that much room would need
+// more places than an int can index, each row gets just the one more,
+// and if even that is too many the program exits.
+{
+	own_arrays();
+
+	long long places = m;
+	bool quarter = false;
+	if (with_room) {
+		for (int i = 0; i < n; i++)
+			places += out_degree(i)/4 + 1;
+		quarter = true;
+		if (places > 0x7fffffff) {
+			places = (long long)m + n;
+			quarter = false;
+		}
+		if (places > 0x7fffffff) {
+			cerr << "error: too many arcs (" << places << ")\n";
+			exit(1);
+		}
+	}
+	int *targets = arc_targets;
+	double *weights = arc_weights;
+	char *old = move_arrays((int)places);
+
+	long long a = 0;
+	for (int i = 0; i < n; i++) {
+		int degree = out_degree(i);
+		memcpy(arc_targets + a, targets + arc_offsets[i], degree*sizeof(int));
+		memcpy(arc_weights + a, weights + arc_offsets[i],
+			degree*sizeof(double));
+		arc_offsets[i] = (int)a;
+		arc_ends[i] = (int)a + degree;
+		a += degree;
+		if (with_room)
+			a += (quarter ? degree/4 : 0) + 1;
+	}
+	arc_offsets[n] = arc_capacity = (int)places;
+
+	free_arena(old);
+	in_valid = false;  // (the arc indices have changed)
+}
+
+void Graph::compact_arcs()
+// Packs the arcs one row after another
+{
+	if (arc_capacity != m)
+		layout_arcs(false);
+}
+
+void Graph::update_incoming()
+// Builds the incoming arc index, if it is out of date.  This is a
+// counting sort of the arcs by end node; scanning the rows in order
+// leaves the sources of each node's incoming arcs in increasing order.
+{
+	if (in_valid)
+		return;
+
+	delete[] in_offsets;
+	delete[] in_sources;
+	delete[] in_arcs;
+	in_offsets = new int[n + 1];
+	in_sources = new int[m];
+	in_arcs = new int[m];
+
+	// count the arcs into each node, then turn the counts into offsets
+	for (int j = 0; j <= n; j++)
+		in_offsets[j] = 0;
+	for (int i = 0; i < n; i++)
+		for (int a = arc_offsets[i]; a < arc_ends[i]; a++)
+			in_offsets[arc_targets[a] + 1]++;
+	for (int j = 0; j < n; j++)
+		in_offsets[j + 1] += in_offsets[j];
+
+	// place the arcs, using 'next' as the fill position of each node
+	vector<int> next(in_offsets, in_offsets + n);
+	for (int i = 0; i < n; i++) {
+		for (int a = arc_offsets[i]; a < arc_ends[i]; a++) {
+			int k = next[arc_targets[a]]++;
+			in_sources[k] = i;
+			in_arcs[k] = a;
+		}
+	}
+	in_valid = true;
+}
+
+// The bit matrix is only kept for graphs with up to this many nodes
+// (at most 128 MB)
+static const int MaxBitMatrixNodes = 32768;
+
+bool Graph::prefers_bit_matrix() const
+// Returns true if this graph is unweighted, and dense enough that the
+// bit matrix takes no more memory than the arc arrays
+{
+	if (weighted || n == 0 || n > MaxBitMatrixNodes)
 		return false;
+	double matrix_bytes = (double)n*n/8;
+	double arc_bytes = (double)m*(sizeof(int) + sizeof(double));
+	return matrix_bytes <= arc_bytes;
+}
+
+void Graph::update_bit_matrix()
+// Builds the bit matrix, if it is out of date.  The rows are padded to
+// whole cache lines (8 words) and the matrix starts on a cache line.
+{
+	if (bits_valid)
+		return;
+
+	if (bit_rows)
+		operator delete[](bit_rows, align_val_t(64));
+	bit_words = (n + 511)/512*8;
+	size_t words = (size_t)n*bit_words;
+	bit_rows = (uint64_t *)operator new[]((words > 0 ? words : 1)
+		*sizeof(uint64_t), align_val_t(64));
+	for (size_t k = 0; k < words; k++)
+		bit_rows[k] = 0;
+
+	for (int i = 0; i < n; i++) {
+		uint64_t *row = bit_rows + (size_t)i*bit_words;
+		for (int a = arc_offsets[i]; a < arc_ends[i]; a++)
+			row[arc_targets[a] >> 6] |= (uint64_t)1 << (arc_targets[a] & 63);
 	}
+	bits_valid = true;
 }
 
 
@@ -855,15 +1455,25 @@ void Graph::set_node_state(int i, int state)
 	if (!check_index(i, n, "set_node_state()"))
 		return;
 
-	// there are no restrictions on the state
-	nodes[i].state = state;
+	// the state has to fit in a byte
+	if (state < 0 || state > 255) {
+		cerr << "set_node_state(): state " << state << " is out of range\n";
+		return;
+	}
+	clear_stale_fields();
+	node_states[i] = (unsigned char)state;
 }
 
 void Graph::set_all_node_states(int state)
 // Sets all the node states to 'state'
 {
-	for (int i = 0; i < n; i++)
-		nodes[i].state = state;
+	if (state < 0 || state > 255) {
+		cerr << "set_all_node_states(): state " << state
+			<< " is out of range\n";
+		return;
+	}
+	clear_stale_fields();
+	memset(node_states, state, n*sizeof(unsigned char));
 }
 
 void Graph::flag_node(int i, unsigned flags)
@@ -875,7 +1485,8 @@ void Graph::flag_node(int i, unsigned flags)
 	if (!check_index(i, n, "flag_node()"))
 		return;
 
-	nodes[i].flags |= flags;
+	clear_stale_fields();
+	node_flags[i] |= flags;
 }
 
 void Graph::unflag_node(int i, unsigned flags)
@@ -887,14 +1498,15 @@ void Graph::unflag_node(int i, unsigned flags)
 	if (!check_index(i, n, "unflag_node()"))
 		return;
 
-	nodes[i].flags &= ~flags;
+	clear_stale_fields();
+	node_flags[i] &= ~flags;
 }
 
 void Graph::set_all_node_flags(unsigned flags)
 // Sets the flags of all the nodes to 'flags'
 {
-	for (int i = 0; i < n; i++)
-		nodes[i].flags = flags;
+	clear_stale_fields();
+	fill(node_flags, node_flags + n, flags);
 }
 
 
@@ -908,14 +1520,13 @@ void Graph::set_node_value(int i, double value)
 		return;
 
 	// there are no restrictions on the value
-	nodes[i].value = value;
+	node_values[i] = value;
 }
 
 void Graph::set_all_node_values(double value)
 // Sets all the node values to 'value'
 {
-	for (int i = 0; i < n; i++)
-		nodes[i].value = value;
+	fill(node_values, node_values + n, value);
 }
 
 /******************/
@@ -924,18 +1535,12 @@ void Graph::set_all_node_values(double value)
 
 Graph *Graph::node_subgraph() const
 // Returns a newly created subgraph of this graph that contains
-// only the nodes (i.e., with all arcs removed).  
+// only the nodes (i.e., with all arcs removed).  Only the nodes are
+// copied; for a subgraph that shares the nodes of this one instead,
+// see 'Subgraph'.
 {
-	// Start by making a copy of 'this'
-	Graph *subgraph = new Graph(*this);
-
-	// remove all the arcs 
-	subgraph->remove_all_arcs();
-
-	// initially make this unweighted
-	subgraph->weighted = false;
-
-	return subgraph;
+	// (it starts out unweighted, with no arcs)
+	return new Graph(*this, false);
 }
 
 
@@ -945,6 +1550,41 @@ Graph *Graph::node_subgraph() const
 
 #ifdef GRAPHICAL
 
+void Graph::set_arc_point(int i, int j, const PDFPoint& p)
+// Sets the point the arc i->j is drawn through, replacing any
+// point already given for it
+{
+	size_t k = 0;
+	while (k < arc_points.size() && arc_points[k].before(i, j))
+		k++;
+	if (k < arc_points.size() && arc_points[k].start == i
+		&& arc_points[k].end == j) {
+		arc_points[k].p = p;
+	}
+	else {
+		ArcPoint point = { i, j, p };
+		arc_points.insert(arc_points.begin() + k, point);
+	}
+}
+
+const PDFPoint *Graph::arc_point(int i, int j) const
+// Returns the point the arc i->j is drawn through, or NULL if there
+// is none
+{
+	size_t lo = 0, hi = arc_points.size();
+	while (lo < hi) {
+		size_t mid = (lo + hi)/2;
+		if (arc_points[mid].before(i, j))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < arc_points.size() && arc_points[lo].start == i
+		&& arc_points[lo].end == j)
+		return &arc_points[lo].p;
+	return NULL;
+}
+
 void Graph::init_PDF(const string& filename)
 // Initializes the associated PDF (actually, 'PDFGraph') object
 // preparing to write to the 'filename'
@@ -965,6 +1605,18 @@ void Graph::draw(unsigned flags, const string& annotation,
 	}
 }
 
+void Graph::draw(unsigned flags, const string& annotation,
+	const Subgraph& beneath)
+	// PRE: the PDF object of this graph is active
+	// The same, drawing the arcs of the view 'beneath' first
+{
+	if (pdf) {
+		pdf->new_page(annotation.c_str());
+		pdf->draw_beneath(flags, &beneath);
+		pdf->draw(flags);
+	}
+}
+
 void Graph::finish_PDF()
 // PRE: the PDF object of this graph is active
 // Completes the PDF object and closes the output file
@@ -985,7 +1637,30 @@ void Graph::finish_PDF()
 /* Node Visiting, with Graphical Output */
 /****************************************/
 
+bool Graph::has_visualizer() const
+// Returns true if visiting a node produces output, i.e., if there
+// is an active PDF object.  The traversals check this before each
+// call to 'visit_node' so that headless runs pay nothing for it.
+{
+#ifdef GRAPHICAL
+	return (pdf != NULL);
+#else
+	return false;
+#endif
+}
+
 void Graph::visit_node(int i, const string& annot, const Graph *beneath)
+{
+	show_visit(i, annot, beneath);
+}
+
+void Graph::visit_node(int i, const string& annot, const Subgraph& beneath)
+{
+	show_visit(i, annot, &beneath);
+}
+
+template <class Beneath>
+void Graph::show_visit(int i, const string& annot, const Beneath *beneath)
 // Graphically displays the act "Visiting" node 'i'.  This amounts to
 // displaying the graph on a new page beginning with 'annot' and 
 //
@@ -997,12 +1672,18 @@ void Graph::visit_node(int i, const string& annot, const Graph *beneath)
 //   - node 'i' is highlighted
 //
 // The idea of 'beneath' is that it can contain a partial spanning
-// tree or other subgraph.
+// tree or other subgraph, either a graph of its own or a view of this
+// one ('Subgraph').
 {
+	// with no PDF attached, there is nothing to do
+	if (!has_visualizer())
+		return;
+
 	// check the index
 	if (!check_index(i, n, "visit_node()"))
 		return;
 
+#ifdef GRAPHICAL
 	// Display the graph on a new page,
 	// starting by adding the node index to the annotation
 	// (There is probably a more C++ way to do this.  Apparently C++-11
@@ -1018,15 +1699,16 @@ void Graph::visit_node(int i, const string& annot, const Graph *beneath)
 	pdf->comment(buf);
 
 	// highlight the node, temporarily
-	unsigned flags0 = nodes[i].flags;
-	nodes[i].flags |= HighlightFlag;
+	clear_stale_fields();
+	unsigned flags0 = node_flags[i];
+	node_flags[i] |= HighlightFlag;
 
 	// Draw the "beneath" graph, if it is specified
 	if (beneath) {
 		// Write the "beneath" graph in text output as a comment
 		ostringstream output;
 		output << "! Beneath graph:" << endl;
-		write(output, true);
+		beneath->write(output, true);
 		pdf->comment(output.str().c_str());
 
 		// draw the "beneath" graph
@@ -1043,6 +1725,7 @@ void Graph::visit_node(int i, const string& annot, const Graph *beneath)
 	pdf->draw();
 
 	// revert the flag of node 'i'
-	nodes[i].flags = flags0;
+	node_flags[i] = flags0;
+#endif
 
 }
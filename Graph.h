@@ -12,8 +12,13 @@
 #define __GRAPHS_H
 
 #include <cstdlib>
+#include <cmath>
+#include <cstring>
 #include <string>
 #include <iostream>
+#include <vector>
+#include <string_view>
+#include <stdint.h>
 
 // Removing this line will omit all the graphic stuff
 #define GRAPHICAL
@@ -24,7 +29,12 @@
 
 using namespace std;
 
+class Graph;
 class PDFGraph;
+class IndexedHeap;
+class ThreadPool;
+class MappedFile;
+class Subgraph;
 
 /**************************************************************************** 
  * 
@@ -50,7 +60,8 @@ struct GraphNode {
     {}
 };
 
-// Constants for use as GraphNode 'state' values 
+// Constants for use as GraphNode 'state' values (a state is stored in
+// a byte, so it must be in the range 0..255)
 const int NoState = 0;
 const int Active   = 1;
 const int Visited  = 2;
@@ -59,6 +70,92 @@ const int Finished = 3;
 // Constants for the GraphNode 'flag' field
 const int HighlightFlag = 1<<0;
 
+// Constants for the 'strategy' argument of the shortest path functions
+const int HeapDijkstra = 0;  // priority queue, O((n + m) log n)
+const int ScanDijkstra = 1;  // linear scan for the minimum, O(n^2)
+
+// The distance to a node that cannot be reached
+const double InfiniteDistance = HUGE_VAL;
+
+// The index of the lowest bit set in 'w' (which must not be 0), and the
+// number of bits set in 'w'; these compile to single instructions
+// ('tzcnt', 'popcnt') where the compiler has them
+inline int lowest_bit( uint64_t w ) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(w);
+#else
+  int k = 0;
+  for (; (w & 1) == 0; w >>= 1)
+    k++;
+  return k;
+#endif
+}
+
+inline int bit_count( uint64_t w ) {
+#if defined(__GNUC__)
+  return __builtin_popcountll(w);
+#else
+  int count = 0;
+  for (; w != 0; w &= w - 1)
+    count++;
+  return count;
+#endif
+}
+
+
+/**************************************************************************** 
+ * 
+ * STRUCT:  ShortestPath
+ * 
+ ****************************************************************************/
+
+// The answer to a point-to-point shortest path query
+
+struct ShortestPath {
+  double distance;   // length of the path (InfiniteDistance if there is none)
+  vector<int> path;  // the nodes along the path, source first (or empty)
+  int settled;       // number of nodes the search settled
+
+  ShortestPath() : distance(InfiniteDistance), settled(0) {}
+};
+
+
+/**************************************************************************** 
+ * 
+ * STRUCT:  SpanningTree
+ * 
+ ****************************************************************************/
+
+// The result of a whole traversal ('breadth_first', 'depth_first', or
+// 'shortest_paths'): the tree it found, as the parent of each node.
+// This takes three arrays of n entries, and it moves rather than copies.
+// A path is read off the tree in time proportional to its length, and
+// the tree is made into a graph of its own only on request ('to_graph').
+
+struct SpanningTree {
+  int root;               // the node the traversal started from
+  vector<int> parent;     // parent of each node (-1 for the root and
+                          // the nodes not reached)
+  vector<double> distance;// length of the tree path from the root to each
+                          // node (in arcs, except for 'shortest_paths',
+                          // where it is the sum of the weights), or
+                          // InfiniteDistance if it wasn't reached
+  vector<int> order;      // the nodes reached, in the order the traversal
+                          // reached them (settled them, for
+                          // 'shortest_paths'), so each comes after its parent
+
+  SpanningTree() : root(-1) {}
+  SpanningTree( SpanningTree&& ) = default;
+  SpanningTree& operator=( SpanningTree&& ) = default;
+  SpanningTree( const SpanningTree& ) = delete;
+  SpanningTree& operator=( const SpanningTree& ) = delete;
+
+  bool reached( int v ) const { return distance[v] != InfiniteDistance; }
+  vector<int> path_to( int v ) const;  // root first (empty if not reached)
+  void set_depths();  // sets 'distance' to the depth of each node
+  Graph *to_graph( const Graph& graph ) const; // the arcs k->parent[k]
+};
+
 
 /**************************************************************************** 
  * 
@@ -72,8 +169,9 @@ class Graph {
  public:
 
   /* Constructors */
-  Graph() {}
-  Graph( const string& filename );
+  Graph() { init(0); }
+  Graph( const string& filename );  // also imports other formats
+  Graph( const string& filename, ThreadPool& pool ); // reads on all threads
   Graph( istream& in ) { read(in, "input"); }
   Graph( const Graph& source );
   ~Graph();                     /* Implement */
@@ -86,6 +184,8 @@ class Graph {
 
   bool is_weighted() const { return weighted; } // true if arcs are weighted
   bool is_directed() const { return directed; } // true if this is directed
+  int node_count() const { return n; }          // number of nodes
+  int arc_count() const { return m; }           // number of arcs
   
   /* Convenience Accessors (Safe) */
   bool adjacent( int i, int j ) const;         // true if there is an arc i->j
@@ -118,46 +218,219 @@ class Graph {
   void set_unweighted() { weighted = false; } // makes the arcs unweighted
   void set_directed()   { directed = true; }  // makes this a direct graph
   void set_undirected() { directed = false; } // makes this an undirected graph
+
+  // Packs the arcs one row after another, giving up the room that adding
+  // and removing arcs leaves after the rows (see "Graph.cpp").  Nothing
+  // needs this, but it saves memory once a graph stops changing.
+  void compact_arcs();
+
+  /* Neighbor iteration (Fast, unchecked)
+   * The outgoing arcs of node 'i' are the arc indices 'a' with
+   * first_arc(i) <= a < last_arc(i), in increasing order of arc_target(a).
+   * Arc indices are only valid until the arcs are next modified, and there
+   * may be unused indices between one row and the next.
+   */
+  int first_arc( int i ) const { return arc_offsets[i]; }
+  int last_arc( int i ) const { return arc_ends[i]; }
+  int out_degree( int i ) const { return arc_ends[i] - arc_offsets[i]; }
+  int arc_target( int a ) const { return arc_targets[a]; }
+  double arc_weight( int a ) const { return arc_weights[a]; }
+
+  /* Incoming arc iteration (Fast, unchecked)
+   * The same, for the arcs coming into node 'j': these are the entries
+   * 'k' with first_in_arc(j) <= k < last_in_arc(j), in increasing order
+   * of in_arc_source(k).  The incoming index is built on demand by
+   * 'update_incoming', and is only valid until the arcs are next added
+   * or removed (weight changes are seen immediately).
+   */
+  void update_incoming();
+  int first_in_arc( int j ) const { return in_offsets[j]; }
+  int last_in_arc( int j ) const { return in_offsets[j + 1]; }
+  int in_arc_source( int k ) const { return in_sources[k]; }
+  int in_arc( int k ) const { return in_arcs[k]; }  // outgoing arc index
+  double in_arc_weight( int k ) const { return arc_weights[in_arcs[k]]; }
+
+  /* Bit matrix adjacency (Fast, unchecked)
+   * For unweighted graphs dense enough that one bit per node pair takes
+   * less memory than the arc arrays ('prefers_bit_matrix'), the arcs can
+   * also be kept as a bit matrix: bit 'j' of row 'i' is set if there is
+   * an arc i->j.  Each row is 'bit_row_words()' 64-bit words, a whole
+   * number of 64-byte cache lines, so a word loop over a row never
+   * straddles a line.  Like the incoming index, the matrix is built on
+   * demand by 'update_bit_matrix', and is only valid until the arcs are
+   * next added or removed.
+   */
+  bool prefers_bit_matrix() const;
+  void update_bit_matrix();
+  int bit_row_words() const { return bit_words; }
+  const uint64_t *bit_row( int i ) const {
+    return bit_rows + (size_t)i*bit_words;
+  }
     
-  /* General node visiting (mostly for graphical output) */
+  /* General node visiting (mostly for graphical output)
+   * Visiting does nothing unless a PDF is attached (see 'init_PDF'),
+   * so the traversals run "headless" with no rendering overhead, and
+   * they skip building the visit annotations entirely.
+   */
   void visit_node( int i, const string& annot = "",
 		   const Graph* beneath = NULL );
+  void visit_node( int i, const string& annot, const Subgraph& beneath );
+  bool has_visualizer() const;  // true if visits are being recorded
 
-  /* Subgraphs */
-  Graph *node_subgraph() const;
+  /* Subgraphs (see also "Subgraph.h", for views that share the nodes) */
+  Graph *node_subgraph() const;  // a copy of the nodes, with no arcs
   
   /* Graph Algorithms (implemented in "GraphAlg.cpp") */
-  Graph* depth_first( int start_i );
-  Graph* breadth_first( int start_i );
-  Graph *shortest_paths( int source_i );
-  void shortest_path( int source_i, int dset_i, ostream *out );
+  SpanningTree depth_first( int start_i );
+  SpanningTree breadth_first( int start_i );
+  SpanningTree shortest_paths( int source_i, int strategy = HeapDijkstra );
+  void shortest_path( int source_i, int dest_i, ostream *out,
+		      int strategy = HeapDijkstra );
+  ShortestPath shortest_path( int source_i, int dest_i,
+			      int strategy = HeapDijkstra );
+  ShortestPath bidirectional_path( int source_i, int dest_i );
+  ShortestPath astar_path( int source_i, int dest_i );
+  void multi_source_bfs( const vector<int>& sources,
+			 vector<int>& hops ) const;
+  void dense_breadth_first( int start_i, vector<int>& parent,
+			    vector<int> *level = NULL,
+			    vector<int> *order = NULL );
+
+  /* Graph Algorithms with a visitor (implemented in "GraphTraversal.h")
+   * The visitor is told about each step of the traversal (see
+   * "GraphVisitor.h"), and 'parent[v]' is set to the node that 'v' was
+   * reached from (-1 for the start node and unreached nodes).
+   */
+  template <class Visitor>
+  void breadth_first( int start_i, Visitor& visitor, vector<int>& parent );
+  template <class Visitor>
+  void depth_first( int start_i, Visitor& visitor, vector<int>& parent,
+		    vector<int> *discover_time = NULL,
+		    vector<int> *finish_time = NULL );
+  template <class Visitor>
+  void shortest_paths( int source_i, Visitor& visitor, vector<double>& dist,
+		       vector<int>& parent, int strategy = HeapDijkstra );
+  template <class Visitor>
+  void direction_optimizing_bfs( int start_i, Visitor& visitor,
+				 vector<int>& parent,
+				 vector<int> *level = NULL );
+
+  /* Parallel Graph Algorithms (implemented in "GraphParallel.cpp")
+   * These run on all the threads of 'pool'.  They do not take visitors
+   * (or draw anything), and they leave every reached node 'Visited'.
+   */
+  void parallel_breadth_first( int start_i, vector<int>& parent,
+			       ThreadPool& pool, vector<int> *level = NULL );
+  void parallel_shortest_paths( int source_i, vector<double>& dist,
+				vector<int>& parent, ThreadPool& pool,
+				double delta = 0 );  // 'delta' <= 0: automatic
+  double delta_stepping_width() const;  // the automatic 'delta'
  
   int minDistance();
   /* Text output */
   ostream& write( ostream& out, bool brief = false,
-		  const string &prefix = "" );
+		  const string &prefix = "" ) const;
+
+  /* Binary snapshots (implemented in "GraphBinary.cpp")
+   * A snapshot holds the arrays of a graph as they are in memory, so
+   * loading one maps the file and points the arrays into it.  Saving
+   * returns false if the file can't be written; loading exits with a
+   * message if the file can't be read or isn't a snapshot.
+   */
+  bool save_binary( const string& filename ) const;
+  static Graph *load_binary( const string& filename );
   
 #ifdef GRAPHICAL
   void init_PDF( const string& filename );
   void draw( unsigned flags = 0, const string& annotation = "",
 	     Graph *beneath = NULL );
+  void draw( unsigned flags, const string& annotation,
+	     const Subgraph& beneath );
   void finish_PDF();
 #endif
   
  private:
 
-  // The nodes are stored in an array of 'GraphNode' objects
-  // NOTE: The indexing of the nodes in the 'nodes' array starts at 0,
-  //       but the indexing in the input file starts at 1.  So normally
-  //       'nodes[k-1]' corresponds to the node of index 'k' in the input
-  //       file as well as in the actual 'GraphNode' instance in 'nodes[k-1]'
-  //       Put another way, 'nodes[k].index == k + 1'
-  int n;     // number of nodes
-  GraphNode *nodes; // array of nodes (always size 'n')
+  // The node fields are stored in separate arrays rather than as an
+  // array of 'GraphNode' objects, so a traversal testing node states
+  // only touches the (one byte per node) 'node_states' array.
+  // NOTE: The indexing of the node arrays starts at 0, but the indexing
+  //       in the input file starts at 1.  So normally entry 'k-1' of
+  //       each array is for the node of index 'k' in the input file.
+  int n;                      // number of nodes
+  unsigned char *node_states; // state of each node (always size 'n')
+  unsigned *node_flags;       // flags of each node
+  double *node_values;        // value of each node
+
+  // A loaded snapshot leaves 'node_states' and 'node_flags' to be zeroed
+  // when they are first used, so loading doesn't touch every node
+  mutable bool fields_stale;  // true until they are zeroed
+  void clear_stale_fields() const {
+    if (fields_stale) {
+      memset(node_states, 0, n*sizeof(unsigned char));
+      memset(node_flags, 0, n*sizeof(unsigned));
+      fields_stale = false;
+    }
+  }
+
+  // Node names are interned: each distinct name is stored once, and
+  // name 'k' is the characters name_chars[name_offsets[k]] up to (not
+  // including) name_chars[name_offsets[k + 1]].  Name 0 is the empty
+  // name of an unnamed node.
+  vector<char> name_chars;
+  vector<uint64_t> name_offsets;
+  int *node_names;            // index of each node's name
+  string_view node_name( int i ) const {
+    const uint64_t *k = name_offsets.data() + node_names[i];
+    return string_view(name_chars.data() + k[0], k[1] - k[0]);
+  }
+  int name_count() const { return (int)name_offsets.size() - 1; }
+  int add_name( string_view name );  // returns the index of the new name
+
+  // The snapshot that 'arc_offsets', 'arc_targets', 'arc_weights',
+  // 'node_values', 'node_names', and 'node_pos' point into (or NULL if
+  // they were allocated).  Its pages are copied as they are written,
+  // but the arrays can't be reallocated or freed while they're in it.
+  MappedFile *snapshot;
+  void own_arrays();  // copies the arrays out of the snapshot, if any
+
+  // The node arrays above, the arc arrays below, and 'node_pos' are all
+  // carved out of one block of memory (the "arena"), each starting on a
+  // 64-byte cache line, so they take one allocation and one free.  The
+  // arc arrays grow by moving everything to a new block.
+  char *arena;
+  size_t arena_size;
+  void allocate_arrays( int capacity );  // frees the old block
+  char *move_arrays( int capacity );     // returns the old block
+  static void free_arena( char *block );
+
+  // The arcs are stored in compressed sparse row (CSR) form, with room
+  // after each row for adding arcs (see the Graph.cpp file for more
+  // information)
+  int m;              // number of arcs
+  int arc_capacity;   // allocated size of 'arc_targets' and 'arc_weights'
+                      // (always arc_offsets[n])
+  int *arc_offsets;   // row 'i' has the places arc_offsets[i]..[i+1]-1,
+  int *arc_ends;      // and its arcs are at arc_offsets[i]..arc_ends[i]-1
+                      // (in a snapshot, whose rows are packed, this is
+                      // just arc_offsets + 1)
+  int *arc_targets;   // end node of each arc (sorted within each row)
+  double *arc_weights;// weight of each arc (always positive)
 
-  // The arcs are represented in an adjacency matrix
-  // (see the Graph.cpp file for more information)
-  double **adj;
+  // The incoming (transpose) index: the arcs again, grouped by end node
+  bool in_valid;      // true if the index matches the arcs
+  int *in_offsets;    // incoming arcs of 'j' are at in_offsets[j]..[j+1]-1
+  int *in_sources;    // start node of each incoming arc
+  int *in_arcs;       // index of each incoming arc in 'arc_targets'
+
+  // The bit matrix: the arcs again, one bit each (see 'bit_row')
+  bool bits_valid;    // true if the matrix matches the arcs
+  int bit_words;      // 64-bit words in each row
+  uint64_t *bit_rows; // row 'i' starts at bit_rows[i*bit_words]
+
+  // The A* heuristic scale: the least weight per unit of distance between
+  // 'node_pos' entries over all the arcs (negative when out of date)
+  double astar_ratio;
 
   // The 'weighted' flag indicates that the arcs are specifically
   // weighted, even if all the values in the adjacency matrix are 1.
@@ -168,23 +441,70 @@ class Graph {
   bool directed;
   
   // Initialization and file input
-  void init( int n_nodes );
+  Graph( const Graph& source, bool with_arcs );
+  void copy_arrays( const Graph& source, bool with_arcs );
+  void init( int n_nodes, int arc_places = 0 );
   void read( istream& in, const string& sourcename );
 
+  // Arc storage helpers
+  struct ArcRecord {
+    int start, end;
+    double weight;
+    bool operator<( const ArcRecord& r ) const {  // row, then column order
+      return (start < r.start || (start == r.start && end < r.end));
+    }
+  };
+  void build_arcs( vector<ArcRecord>& arcs );
+  void build_arcs( vector< vector<ArcRecord> >& parts, ThreadPool& pool );
+  void set_row_ends();  // for rows packed with no room between them
+  int find_arc( int i, int j ) const;
+  void insert_arc( int i, int j, double weight );
+  bool borrow_room( int i );
+  void erase_arcs( int i, int first, int last );
+  void layout_arcs( bool with_room );
+
   // Traversal "helper" functions
-  void depth_first( int i, Graph *spanning_tree );
+  int settle_next( vector<double>& dist, IndexedHeap *heap );
+  static void trace_path( const vector<int>& parent, int dest_i,
+			  vector<int>& path );
+  void update_astar_ratio();
+  void draw_tree( const SpanningTree& tree, const string& annotation );
+  template <class Beneath>
+  void show_visit( int i, const string& annot, const Beneath *beneath );
+
+  // The two parts of 'write' around the arcs, which 'Subgraph' shares
+  void write_nodes( ostream& out, bool brief, const string& prefix ) const;
+  void write_layout( ostream& out, const string& prefix ) const;
+
+  // The fast text reader fills in the arrays directly
+  friend class GraphParser;
+  friend class Subgraph;
   
 #ifdef GRAPHICAL
   // Graphical stuff
   
   double scale;  
   PDFPoint *node_pos;
-  PDFPoint ***arc_pos;
+
+  // Arc points are rare, so they are kept in a list sorted by (start, end)
+  // rather than alongside every arc
+  struct ArcPoint {
+    int start, end;
+    PDFPoint p;
+    bool before( int i, int j ) const {  // true if this comes before i->j
+      return (start < i || (start == i && end < j));
+    }
+  };
+  vector<ArcPoint> arc_points;
+  void set_arc_point( int i, int j, const PDFPoint& p );
+  const PDFPoint *arc_point( int i, int j ) const;
 
   friend class PDFGraph;
   PDFGraph *pdf;
 #endif
 };  /* End of class 'Graph' */
 
+// The templated traversals
+#include "GraphTraversal.h"
 
 #endif
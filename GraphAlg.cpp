@@ -9,45 +9,57 @@
 #include <sstream>
 #include <fstream>
 #include <vector>
+#include <algorithm>
+#include <new>
 #include "Graph.h"
+#include "GraphParser.h"
+#include "GraphVisitor.h"
+#include "IndexedHeap.h"
+#include "MultiSourceBFS.h"
 #include "PDF.h"
 #include "PDFGraph.h"
+#include "Subgraph.h"
 
 using namespace std;
 
+// Index domain check (in "Graph.cpp")
+bool check_index(int i, int n, const char *msg);
+
 //  DeConstructor
 //  insures that no memory is leaked
 //
 Graph::~Graph()
 {
-	delete[] nodes;
-	nodes = NULL;
-	for (int i = 0; i < n; i++)
-	{
-		delete[] adj[i];
-		adj[i] = NULL;
-	}
-	delete[] adj;
-	adj = NULL;
-	for (int j = 0; j < n; j++)
-	{
-		for (int k = 0; k < n; k++)
-		{
-			if (arc_pos[j][k] != NULL)
-				delete arc_pos[j][k];
-			arc_pos[j][k] = NULL;
-		}
-		delete[] arc_pos[j];
-		arc_pos[j] = NULL;
-	}
-	delete[] arc_pos;
-	arc_pos = NULL;
-	delete[] node_pos;
+	// The node and arc arrays are all in the arena (or in the snapshot,
+	// which takes them with it)
+	delete snapshot;
+	snapshot = NULL;
+	free_arena(arena);
+	arena = NULL;
+	node_states = NULL;
+	node_flags = NULL;
+	node_values = NULL;
+	node_names = NULL;
+	arc_offsets = arc_ends = arc_targets = NULL;
+	arc_weights = NULL;
+#ifdef GRAPHICAL
 	node_pos = NULL;
+#endif
+
+	// (the incoming index and the bit matrix are built separately)
+	delete[] in_offsets;
+	in_offsets = NULL;
+	delete[] in_sources;
+	in_sources = NULL;
+	delete[] in_arcs;
+	in_arcs = NULL;
+	if (bit_rows)
+		operator delete[](bit_rows, align_val_t(64));
+	bit_rows = NULL;
 }
 
 //-----------------------------------------------------------------------------
-//	Function: Graph* breadth_first( int start_i )
+//	Function: SpanningTree breadth_first( int start_i )
 //  
 //	Title:	Graph
 //
@@ -62,46 +74,43 @@ Graph::~Graph()
 //	Date: 2/20/2014
 //
 //  Returns: a spanning tree representing the result of a breadth-first 
-//		traversal 
+//		traversal (the distances are the numbers of arcs)
 //  Parameters: int representing the node from which to start traversing 
-//  Version: 1.0
+//  Version: 1.1
 //  Environment: AMD FX 8-core Processor 8350 4.0GHZ
 //				 Windows 8.1 Pro 64-bit
 //
 //-----------------------------------------------------------------------------
-Graph* Graph::breadth_first(int start_i)
+SpanningTree Graph::breadth_first(int start_i)
 {
-	vector<int> queue;
-	// Create a copy of the ndoes of this graph, to serve as a spanning tree
-	Graph *spanning_tree = node_subgraph();
-	int front, rear, root;
-	front = rear = 0;
-	visit_node(start_i, " Breadth First Algorithm ", spanning_tree);
-	set_node_state(start_i, 2);
-	queue.push_back(start_i);
-	rear++; 
-	while (front != rear)
+	SpanningTree tree;
+	tree.root = start_i;
+	if (has_visualizer())
 	{
-		root = queue[front];
-		for (int k = 0; k < n; k++)
-			if (adj[root][k] && !(nodes[k].state == 2))
-			{
-				set_node_state(k, 2);
-				queue.push_back(k);
-				rear++;
-				spanning_tree->add_arc(k, root);
-				visit_node(k, " Breadth First Algorithm ", spanning_tree);
-			}
-		front++;
+		PDFVisitor visitor(this, tree.parent, tree.order,
+			" Breadth First Algorithm ");
+		breadth_first(start_i, visitor, tree.parent);
+	}
+	else if (prefers_bit_matrix())
+	{
+		// (the same tree, found a word of the bit matrix at a time)
+		dense_breadth_first(start_i, tree.parent, NULL, &tree.order);
+	}
+	else
+	{
+		OrderVisitor visitor(tree.order);
+		breadth_first(start_i, visitor, tree.parent);
 	}
+	tree.set_depths();
+
 	// Draw the completed version
-	draw(0, "Completed Breadth-first traversal", spanning_tree);
-	return spanning_tree;
+	draw_tree(tree, "Completed Breadth-first traversal");
+	return tree;
 }
 
 
 //-----------------------------------------------------------------------------
-//	Function: Graph* depth_first( int start_i )
+//	Function: SpanningTree depth_first( int start_i )
 //  
 //	Title:	Graph
 //
@@ -114,185 +123,704 @@ Graph* Graph::breadth_first(int start_i)
 //	Date: 2/20/2014
 //
 //  Returns: a spanning tree representing the result of a depth-first 
-//		traversal 
+//		traversal (the distances are the depths in the tree)
 //  Parameters: int representing the node from which to start traversing 
-//  Version: 1.0
+//  Version: 1.1
 //  Environment: AMD FX 8-core Processor 8350 4.0GHZ
 //				 Windows 8.1 Pro 64-bit
 //
 //-----------------------------------------------------------------------------
-Graph* Graph::depth_first(int start_i)
+SpanningTree Graph::depth_first(int start_i)
 {
 	// To prepare for the search, set all the the node states to 0
 	set_all_node_states(0);
 
 	// Draw the graph as it is given
-	pdf->new_page("Running Depth-first traversal:");
-	pdf->draw();
-
-	// Create a copy of the ndoes of this graph, to serve as a spanning tree
-	Graph *spanning_tree = node_subgraph();
+#ifdef GRAPHICAL
+	if (has_visualizer())
+	{
+		pdf->new_page("Running Depth-first traversal:");
+		pdf->draw();
+	}
+#endif
 
 	// Perform the algorithm
-	depth_first(start_i, spanning_tree);
+	SpanningTree tree;
+	tree.root = start_i;
+	if (has_visualizer())
+	{
+		PDFVisitor visitor(this, tree.parent, tree.order,
+			" Depth First Algorithm ");
+		depth_first(start_i, visitor, tree.parent);
+	}
+	else
+	{
+		OrderVisitor visitor(tree.order);
+		depth_first(start_i, visitor, tree.parent);
+	}
+	tree.set_depths();
 
 	// Draw the completed version
-	draw(0, "Completed depth-first traversal", spanning_tree);
-	return spanning_tree;
+	draw_tree(tree, "Completed depth-first traversal");
+	return tree;
 }
 
 
 //-----------------------------------------------------------------------------
-//	Function: Graph* depth_first( int i, Graph* spanning_tree )
+//	Function: int settle_next( vector<double>& dist, IndexedHeap *heap )
 //  
 //	Title:	Graph
 //
 //	Description:
-//				helper method for depth-first traversal
+//				helper method for Dijkstra's algorithm: picks the unsettled
+//     node with the smallest tentative distance and marks it settled.  If
+//     'heap' is NULL the nodes are scanned for the minimum (O(n) per call,
+//     the 'ScanDijkstra' strategy); otherwise the minimum is popped
+//     from 'heap' (O(log n) per call, the 'HeapDijkstra' strategy).
+//
+//  Returns: the index of the node settled, or -1 if every remaining node
+//     is unreachable
+//
+//  Parameters: the tentative distance of each node, and the heap of
+//     unsettled reached nodes (or NULL)
+//
+//-----------------------------------------------------------------------------
+int Graph::settle_next(vector<double>& dist, IndexedHeap *heap)
+{
+	int u = -1;
+	if (heap)
+	{
+		if (!heap->empty())
+			u = heap->pop();
+	}
+	else
+	{
+		double min = InfiniteDistance;
+		for (int v = 0; v < n; v++)
+			if (!(node_states[v] == 2) && dist[v] < min)
+				min = dist[v], u = v;
+	}
+
+	if (u != -1)
+		set_node_state(u, 2);
+	return u;
+}
+
+
+//-----------------------------------------------------------------------------
+//	Function: SpanningTree shortest_paths( int start_i, int strategy )
+//  
+//	Title:	Graph
+//
+//	Description:
+//				Traversal of a graph using Dijkstra's algorithm,
+//     the shortest path from any node is displayed graphically in a pdf
 //	
 //	Programmer: Bret Van Hof and Daniel Smith
 //	
 //	Date: 2/20/2014
 //
-//  Returns: a spanning tree representing the result of a breadth-first 
-//		traversal 
-//  Parameters: int representing the node from which to start traversing,
-//       the spanning tree used in representing the traversal 
-//  Version: 1.0
+//  Returns: a spanning tree representing the shortest path to any node
+//     (the distances are the lengths of the shortest paths)
+//
+//  Parameters: int representing the node to which the path goes, and
+//     the strategy used to find the next node ('HeapDijkstra' by default,
+//     or 'ScanDijkstra' for the O(n^2) scan, which can win on dense graphs)
+//  Version: 1.2
 //  Environment: AMD FX 8-core Processor 8350 4.0GHZ
 //				 Windows 8.1 Pro 64-bit
 //
 //-----------------------------------------------------------------------------
-void Graph::depth_first(int i, Graph *spanning_tree)
+SpanningTree Graph::shortest_paths(int start_i, int strategy)
 {
-	visit_node(i, " Depth First Algorithm ", spanning_tree);
-	set_node_state(i, 2);
-	for (int l = 0; l < n; l++)
+	SpanningTree tree;
+	tree.root = start_i;
+	if (has_visualizer())
 	{
-		if (adj[i][l] && !(nodes[l].state == 2))
-		{
-			spanning_tree->add_arc(l, i);
-			depth_first(l, spanning_tree);
-		}
+		PDFVisitor visitor(this, tree.parent, tree.order,
+			" Shortest Path Algorithm ", true);
+		shortest_paths(start_i, visitor, tree.distance, tree.parent, strategy);
 	}
+	else
+	{
+		OrderVisitor visitor(tree.order, true);
+		shortest_paths(start_i, visitor, tree.distance, tree.parent, strategy);
+	}
+
+	draw_tree(tree, "Completed Shortest path traversal");
+	return tree;
+}
+
+
+//-----------------------------------------------------------------------------
+//	Function: void draw_tree( const SpanningTree& tree,
+//                            const string& annotation )
+//  
+//	Title:	Graph
+//
+//	Description:
+//				draws this graph on a new page, over the arcs of 'tree'
+//     (a view of the nodes of this graph is made for them, so nothing is
+//     done at all unless a PDF is attached)
+//
+//  Returns: N/A
+//
+//  Parameters: the tree, and the annotation for the page
+//
+//-----------------------------------------------------------------------------
+void Graph::draw_tree(const SpanningTree& tree, const string& annotation)
+{
+	if (!has_visualizer())
+		return;
+#ifdef GRAPHICAL
+	Subgraph view(*this);
+	view.set_tree_arcs(tree.parent);
+	draw(0, annotation, view);
+#endif
 }
 
+
 //-----------------------------------------------------------------------------
-//	Function: Graph* shortest_paths( int start_i )
+//	Function: void shortest_path(  int source_i, int dest_i, ostream *out,
+//                                   int strategy )
 //  
 //	Title:	Graph
 //
 //	Description:
 //				Traversal of a graph using Dijkstra's algorithm,
-//     the shortest path from any node is displayed graphically in a pdf
+//     the length of the shortest path to 'dest_i' and the nodes along it
+//     are output to 'out'
 //	
 //	Programmer: Bret Van Hof and Daniel Smith
 //	
 //	Date: 2/20/2014
 //
-//  Returns: a spanning tree representing the shortest path to any node
+//  Returns: N/A
 //
-//  Parameters: int representing the node to which the path goes 
-//  Version: 1.0
+//  Parameters: int representing the node from which the path goes, int
+//	representing the node to which it goes, a pointer to an ostream which
+//	is used to print the info, and the strategy used to find the next
+//	node (as in 'shortest_paths')
+//  Version: 1.1
 //  Environment: AMD FX 8-core Processor 8350 4.0GHZ
 //				 Windows 8.1 Pro 64-bit
 //
 //-----------------------------------------------------------------------------
-Graph* Graph::shortest_paths(int start_i)
+void Graph::shortest_path(int source_i, int dest_i, ostream *out, int strategy)
 {
-	Graph *spanning_tree = node_subgraph();
-	vector<int> dist;
-	// Initialize all distances as INFINITE and stpSet[] as false
-	for (int i = 0; i < n; i++)
-		dist.push_back(INT_MAX), set_node_state(i, 0);
+	if (!check_index(source_i, n, "shortest_path() (source index)"))
+		return;
+	if (!check_index(dest_i, n, "shortest_path() (destination index)"))
+		return;
+	ShortestPath result = shortest_path(source_i, dest_i, strategy);
+
+	// print the distance, and the path (if there is one)
+	(*out) << "Distance from " << node_name(source_i) << " to "
+		<< node_name(dest_i) << ": " << result.distance << endl;
+	if (result.path.empty())
+		(*out) << "No path" << endl;
+	for (size_t k = 0; k < result.path.size(); k++)
+		(*out) << "  " << node_name(result.path[k]) << endl;
+}
+
+
+//-----------------------------------------------------------------------------
+//	Function: ShortestPath shortest_path( int source_i, int dest_i,
+//	                                      int strategy )
+//  
+//	Title:	Graph
+//
+//	Description:
+//				a point-to-point query: Dijkstra's algorithm from
+//     'source_i' that stops as soon as 'dest_i' is settled, so only the
+//     nodes closer to the source than the destination are settled
+//
+//  Returns: the distance to 'dest_i', the nodes along the path, and
+//     the number of nodes settled
+//
+//  Parameters: int representing the source node, int representing the
+//     destination node, and the strategy used to find the next node (as
+//     in 'shortest_paths')
+//
+//-----------------------------------------------------------------------------
+ShortestPath Graph::shortest_path(int source_i, int dest_i, int strategy)
+{
+	ShortestPath result;
+	if (!check_index(source_i, n, "shortest_path() (source index)"))
+		return result;
+	if (!check_index(dest_i, n, "shortest_path() (destination index)"))
+		return result;
+
+	TargetVisitor visitor(dest_i, true);
+	vector<double> dist;
+	vector<int> parent;
+	shortest_paths(source_i, visitor, dist, parent, strategy);
+
+	result.distance = dist[dest_i];
+	result.settled = (int)visitor.finished;
+	if (visitor.found)
+		trace_path(parent, dest_i, result.path);
+	return result;
+}
+
 
-	// Distance of source vertex from itself is always 0
-	dist[start_i] = 0;
-	for (int count = 0; count < n; count++)
+//-----------------------------------------------------------------------------
+//	Function: ShortestPath bidirectional_path( int source_i, int dest_i )
+//  
+//	Title:	Graph
+//
+//	Description:
+//				a point-to-point query by bidirectional Dijkstra: one
+//     search runs forward from 'source_i' over the outgoing arcs, the
+//     other backward from 'dest_i' over the incoming arcs, and each step
+//     advances the one whose next node is closer.  Whenever an arc joins
+//     the two searches, the path through it is a candidate.  Once the two
+//     smallest keys add up to at least the best candidate, no shorter path
+//     can remain, and the search stops.  Each search only has to reach
+//     about half way, so far fewer nodes are settled than by
+//     'shortest_path'.
+//
+//  Returns: the distance to 'dest_i', the nodes along the path, and
+//     the number of nodes settled (by both searches)
+//
+//  Parameters: int representing the source node, and int representing
+//     the destination node
+//
+//-----------------------------------------------------------------------------
+ShortestPath Graph::bidirectional_path(int source_i, int dest_i)
+{
+	ShortestPath result;
+	if (!check_index(source_i, n, "bidirectional_path() (source index)"))
+		return result;
+	if (!check_index(dest_i, n, "bidirectional_path() (destination index)"))
+		return result;
+
+	update_incoming();
+	set_all_node_states(0);
+
+	// index 0 is the forward search, index 1 the backward search;
+	// in the backward search 'parent' is the next node toward 'dest_i'
+	vector<double> dist[2];
+	vector<int> parent[2];
+	vector<char> settled[2];
+	IndexedHeap heap0(n), heap1(n);
+	IndexedHeap *heap[2] = { &heap0, &heap1 };
+	for (int side = 0; side < 2; side++)
+	{
+		dist[side].assign(n, InfiniteDistance);
+		parent[side].assign(n, -1);
+		settled[side].assign(n, 0);
+	}
+	dist[0][source_i] = 0;
+	heap[0]->push(source_i, 0);
+	dist[1][dest_i] = 0;
+	heap[1]->push(dest_i, 0);
+
+	// the best path found so far goes through the arc 'meet_u'->'meet_v'
+	// (or through the node 'meet_u' if 'meet_v' is -1)
+	double best = (source_i == dest_i ? 0 : InfiniteDistance);
+	int meet_u = source_i, meet_v = -1;
+
+	while (!heap[0]->empty() && !heap[1]->empty()
+		&& heap[0]->top_key() + heap[1]->top_key() < best)
 	{
-		int min = INT_MAX, min_index;
+		int side = (heap[0]->top_key() <= heap[1]->top_key() ? 0 : 1);
+		int u = heap[side]->pop();
+		settled[side][u] = 1;
+		node_states[u] = Visited;
+		result.settled++;
+
+		int first = (side == 0 ? first_arc(u) : first_in_arc(u));
+		int last = (side == 0 ? last_arc(u) : last_in_arc(u));
+		for (int k = first; k < last; k++)
+		{
+			int v = (side == 0 ? arc_target(k) : in_arc_source(k));
+			double d = dist[side][u] + (side == 0 ? arc_weight(k)
+				: in_arc_weight(k));
+			if (!settled[side][v] && d < dist[side][v])
+			{
+				dist[side][v] = d;
+				parent[side][v] = u;
+				heap[side]->push_or_decrease(v, d);
+			}
+			// a path through the arc u-v, if the other search reached 'v'
+			if (dist[1 - side][v] != InfiniteDistance
+				&& d + dist[1 - side][v] < best)
+			{
+				best = d + dist[1 - side][v];
+				meet_u = (side == 0 ? u : v);
+				meet_v = (side == 0 ? v : u);
+			}
+		}
+	}
 
-		for (int v = 0; v < n; v++)
-			if (!(nodes[v].state == 2) && dist[v] <= min)
-				min = dist[v], min_index = v;
+	result.distance = best;
+	if (best == InfiniteDistance)
+		return result;
 
-		int u = min_index;
+	// the forward part ends at 'meet_u'; the backward part starts at
+	// 'meet_v' and follows the backward parents to 'dest_i'
+	trace_path(parent[0], meet_u, result.path);
+	for (int v = meet_v; v != -1; v = parent[1][v])
+		result.path.push_back(v);
+	return result;
+}
 
-		if (u == -1)
-			break;
 
-		visit_node(u, " Shortest Path Algorithm ", spanning_tree);
-		set_node_state(u, 2);
+//-----------------------------------------------------------------------------
+//	Function: ShortestPath astar_path( int source_i, int dest_i )
+//  
+//	Title:	Graph
+//
+//	Description:
+//				a point-to-point query by A* search: Dijkstra's algorithm
+//     with each node keyed by its distance from 'source_i' plus a lower
+//     bound on its distance to 'dest_i'.  The bound is the straight line
+//     distance between the 'node_pos' entries, times the least weight per
+//     unit of length of any arc (see 'update_astar_ratio'), so it never
+//     overestimates and the search can stop when 'dest_i' is removed from
+//     the queue.  On graphs whose weights follow their geometry, as on road
+//     maps, the search heads toward 'dest_i' and settles far fewer nodes.
+//     Without node positions the bound is 0 and this is plain Dijkstra.
+//
+//  Returns: the distance to 'dest_i', the nodes along the path, and
+//     the number of nodes settled
+//
+//  Parameters: int representing the source node, and int representing
+//     the destination node
+//
+//-----------------------------------------------------------------------------
+ShortestPath Graph::astar_path(int source_i, int dest_i)
+{
+	ShortestPath result;
+	if (!check_index(source_i, n, "astar_path() (source index)"))
+		return result;
+	if (!check_index(dest_i, n, "astar_path() (destination index)"))
+		return result;
 
+	update_astar_ratio();
+	set_all_node_states(0);
 
-		for (int v = 0; v < n; v++)
-			if (!(nodes[v].state == 2) && adj[u][v] && dist[u] != INT_MAX
-				&& dist[u] + adj[u][v] < dist[v])
+	// 'bound[v]' is the lower bound on the distance from 'v' to 'dest_i'
+	// (computed when 'v' is first reached)
+	vector<double> dist(n, InfiniteDistance), bound(n, -1);
+	vector<int> parent(n, -1);
+	IndexedHeap heap(n);
+	dist[source_i] = 0;
+	heap.push(source_i, 0);
+
+	while (!heap.empty())
+	{
+		int u = heap.pop();
+		node_states[u] = Visited;
+		result.settled++;
+		if (u == dest_i)
+			break;
+
+		for (int k = first_arc(u); k < last_arc(u); k++)
+		{
+			int v = arc_target(k);
+			double d = dist[u] + arc_weight(k);
+			if (d < dist[v])
 			{
-				spanning_tree->remove_outgoing_arcs(v);
-				dist[v] = dist[u] + adj[u][v];
-				spanning_tree->add_arc(v, u);
+				if (bound[v] < 0)
+				{
+#ifdef GRAPHICAL
+					bound[v] = astar_ratio*node_pos[v].dist(node_pos[dest_i]);
+#else
+					bound[v] = 0;
+#endif
+				}
+				// a node may be reopened if rounding made the bound
+				// slightly inconsistent
+				dist[v] = d;
+				parent[v] = u;
+				heap.push_or_decrease(v, d + bound[v]);
 			}
+		}
 	}
 
-	draw(0, "Completed Shortest path traversal", spanning_tree);
-	return spanning_tree;
+	result.distance = dist[dest_i];
+	if (result.distance != InfiniteDistance)
+		trace_path(parent, dest_i, result.path);
+	return result;
 }
 
 
 //-----------------------------------------------------------------------------
-//	Function: Graph* shortest_path(  int source_i, int dset_i, ostream *out )
+//	Function: void update_astar_ratio()
 //  
 //	Title:	Graph
 //
 //	Description:
-//				Traversal of a graph using Dijkstra's algorithm,
-//     the length of the shortest path to each node is output to the console
-//	
-//	Programmer: Bret Van Hof and Daniel Smith
-//	
-//	Date: 2/20/2014
+//				computes the scale of the A* bound, if it is out of date:
+//     the least ratio of an arc's weight to the distance between the
+//     positions of its ends.  Any path is then at least this ratio times
+//     the straight line distance between its ends.  Arcs whose ends share
+//     a position are skipped; if there are no others (e.g., no node has a
+//     position) the ratio is 0, which turns the bound off.
 //
 //  Returns: N/A
 //
-//  Parameters: int representing the node to which the path goes, an unused int,
-//	and a reference to an ostream which is used to print the info 
-//  Version: 1.0
-//  Environment: AMD FX 8-core Processor 8350 4.0GHZ
-//				 Windows 8.1 Pro 64-bit
+//  Parameters: N/A
 //
 //-----------------------------------------------------------------------------
-void Graph::shortest_path(int source_i, int dset_i, ostream *out)
+void Graph::update_astar_ratio()
 {
-	vector<int> dist;
+	if (astar_ratio >= 0)
+		return;
 
+	astar_ratio = 0;
+#ifdef GRAPHICAL
+	double least = InfiniteDistance;
 	for (int i = 0; i < n; i++)
-		dist.push_back(INT_MAX), set_node_state(i, 0);
+	{
+		for (int k = first_arc(i); k < last_arc(i); k++)
+		{
+			double length = node_pos[i].dist(node_pos[arc_target(k)]);
+			if (length > 0 && arc_weight(k) / length < least)
+				least = arc_weight(k) / length;
+		}
+	}
+	// shaved a little, so rounding cannot push the bound past the
+	// true distance
+	if (least != InfiniteDistance)
+		astar_ratio = least*(1 - 1e-9);
+#endif
+}
 
-	dist[source_i] = 0;
+//-----------------------------------------------------------------------------
+//	Function: void multi_source_bfs( const vector<int>& sources,
+//                                   vector<int>& hops ) const
+//  
+//	Title:	Graph
+//
+//	Description:
+//				breadth-first traversals from every node in 'sources',
+//     run up to 512 at a time by MultiSourceBFS (see "MultiSourceBFS.h"),
+//     which scans the arcs of a node once for all the traversals that
+//     reach it at the same level.  A batch of 64 or fewer sources uses
+//     one-word bit sets, and 256 or fewer four words.
+//
+//  Returns: N/A
+//
+//  Parameters: the start nodes, and the array that gets the number of
+//     arcs from sources[s] to each node v at hops[s*n + v] (or -1 if
+//     v isn't reached)
+//
+//-----------------------------------------------------------------------------
+template <int Words>
+static void multi_source_batches(const Graph& graph,
+	const vector<int>& sources, vector<int>& hops)
+// Runs MultiSourceBFS<Words> on 'sources', a batch at a time
+{
+	const int n = graph.node_count();
+	const int width = MultiSourceBFS<Words>::Width;
+	MultiSourceBFS<Words> bfs(graph);
+	vector<int> batch, batch_hops;
+	for (size_t first = 0; first < sources.size(); first += width)
+	{
+		size_t last = min(first + width, sources.size());
+		batch.assign(sources.begin() + first, sources.begin() + last);
+		bfs.run(batch, &batch_hops);
+		copy(batch_hops.begin(), batch_hops.end(),
+			hops.begin() + first*n);
+	}
+}
 
-	for (int count = 0; count < n - 1; count++)
+void Graph::multi_source_bfs(const vector<int>& sources,
+	vector<int>& hops) const
+{
+	for (size_t s = 0; s < sources.size(); s++)
+		if (!check_index(sources[s], n, "multi_source_bfs()"))
+			return;
+
+	hops.assign(sources.size()*n, -1);
+	if (sources.size() <= 64)
+		multi_source_batches<1>(*this, sources, hops);
+	else if (sources.size() <= 256)
+		multi_source_batches<4>(*this, sources, hops);
+	else
+		multi_source_batches<8>(*this, sources, hops);
+}
+
+//-----------------------------------------------------------------------------
+//	Function: void dense_breadth_first( int start_i, vector<int>& parent,
+//                                      vector<int> *level,
+//                                      vector<int> *order )
+//  
+//	Title:	Graph
+//
+//	Description:
+//				a breadth-first traversal over the bit matrix (see
+//     'update_bit_matrix'), for dense unweighted graphs.  The unvisited
+//     nodes are a bit set too, so the new neighbors of a node are found
+//     64 at a time, as its matrix row AND the unvisited set; they are then
+//     picked out of each word with 'lowest_bit'.  The traversal stops as
+//     soon as every node has been reached, rather than scanning the rows
+//     of the rest of the queue.  Nodes are discovered in the same order
+//     as by 'breadth_first', so the tree is the same, and the reached
+//     nodes are marked Visited in the same way.
+//
+//  Returns: N/A
+//
+//  Parameters: int representing the node from which to start traversing,
+//     the array that gets the parent of each node in the tree (-1 for
+//     the start and unreached nodes), and optionally the arrays that get
+//     the number of arcs from the start to each node (-1 if unreached)
+//     and the reached nodes in the order they were discovered
+//
+//-----------------------------------------------------------------------------
+void Graph::dense_breadth_first(int start_i, vector<int>& parent,
+	vector<int> *level, vector<int> *order)
+{
+	parent.assign(n, -1);
+	if (level)
+		level->assign(n, -1);
+	if (order)
+		order->clear();
+	if (!check_index(start_i, n, "dense_breadth_first()"))
+		return;
+	update_bit_matrix();
+	set_all_node_states(0);
+
+	vector<uint64_t> unvisited(bit_words, 0);
+	for (int v = 0; v < n; v++)
+		unvisited[v >> 6] |= (uint64_t)1 << (v & 63);
+	unvisited[start_i >> 6] &= ~((uint64_t)1 << (start_i & 63));
+	int remaining = n - 1;
+
+	vector<int> queue;
+	queue.reserve(n);
+	queue.push_back(start_i);
+	node_states[start_i] = Visited;
+	if (level)
+		(*level)[start_i] = 0;
+	for (size_t head = 0; head < queue.size() && remaining > 0; head++)
 	{
+		int u = queue[head];
+		const uint64_t *row = bit_row(u);
+		for (int w = 0; w < bit_words; w++)
+		{
+			uint64_t fresh = row[w] & unvisited[w];
+			if (fresh == 0)
+				continue;
+			unvisited[w] &= ~fresh;
+			remaining -= bit_count(fresh);
+			for (; fresh != 0; fresh &= fresh - 1)
+			{
+				int v = 64*w + lowest_bit(fresh);
+				parent[v] = u;
+				node_states[v] = Visited;
+				if (level)
+					(*level)[v] = (*level)[u] + 1;
+				queue.push_back(v);
+			}
+		}
+	}
 
-		int min = INT_MAX, min_index;
+	// (the queue holds the nodes in the order they were discovered)
+	if (order)
+		order->swap(queue);
+}
 
-		for (int v = 0; v < n; v++)
-			if (!(nodes[v].state == 2) && dist[v] <= min)
-				min = dist[v], min_index = v;
-		int u = min_index;
+//-----------------------------------------------------------------------------
+//	Function: void trace_path( const vector<int>& parent, int dest_i,
+//                             vector<int>& path )
+//  
+//	Title:	Graph
+//
+//	Description:
+//				follows the parent links from 'dest_i' back to the root of
+//     the tree, and stores the nodes met in 'path' in root-first order
+//
+//  Returns: N/A
+//
+//  Parameters: the parent array of the tree, the node to trace from,
+//     and the array to fill in
+//
+//-----------------------------------------------------------------------------
+void Graph::trace_path(const vector<int>& parent, int dest_i,
+	vector<int>& path)
+{
+	path.clear();
+	for (int v = dest_i; v != -1; v = parent[v])
+		path.push_back(v);
+	reverse(path.begin(), path.end());
+}
 
-		// Mark the picked vertex as processed
-		set_node_state(u, 2);
 
-		for (int v = 0; v < n; v++)
+//-----------------------------------------------------------------------------
+//	Function: vector<int> SpanningTree::path_to( int v ) const
+//  
+//	Title:	SpanningTree
+//
+//	Description:
+//				the tree path from the root to 'v', found by following
+//     the parent links up from 'v' (so it takes time proportional to the
+//     depth of 'v', not to the size of the tree)
+//
+//  Returns: the nodes on the path, root first (empty if 'v' wasn't
+//     reached)
+//
+//  Parameters: the node the path goes to
+//
+//-----------------------------------------------------------------------------
+vector<int> SpanningTree::path_to(int v) const
+{
+	vector<int> path;
+	if (reached(v))
+	{
+		for (; v != -1; v = parent[v])
+			path.push_back(v);
+		reverse(path.begin(), path.end());
+	}
+	return path;
+}
 
-			if (!(nodes[v].state == 2) && adj[u][v] && dist[u] != INT_MAX
-				&& dist[u] + adj[u][v] < dist[v])
-				dist[v] = dist[u] + adj[u][v];
+//-----------------------------------------------------------------------------
+//	Function: void SpanningTree::set_depths()
+//  
+//	Title:	SpanningTree
+//
+//	Description:
+//				sets the distance of each node to the number of arcs
+//     between it and the root, in one pass over 'order' (each node comes
+//     after its parent there, so the parent's depth is always known)
+//
+//  Returns: N/A
+//
+//  Parameters: N/A
+//
+//-----------------------------------------------------------------------------
+void SpanningTree::set_depths()
+{
+	distance.assign(parent.size(), InfiniteDistance);
+	for (size_t k = 0; k < order.size(); k++)
+	{
+		int v = order[k];
+		distance[v] = (parent[v] == -1 ? 0 : distance[parent[v]] + 1);
 	}
-	// print the constructed distance array
-	(*out) << "Vertex   Distance from Source" << endl;
-	for (int mi = 0; mi < n; mi++)
-		(*out) << nodes[mi].name << "  " << dist[mi] << endl;
 }
 
+//-----------------------------------------------------------------------------
+//	Function: Graph *SpanningTree::to_graph( const Graph& graph ) const
+//  
+//	Title:	SpanningTree
+//
+//	Description:
+//				makes the tree into a graph: the nodes of 'graph' (which
+//     the tree was found in), with an arc from each reached node to its
+//     parent
+//
+//  Returns: a newly created graph, which the caller deletes
+//
+//  Parameters: the graph the tree was found in
+//
+//-----------------------------------------------------------------------------
+Graph *SpanningTree::to_graph(const Graph& graph) const
+{
+	Subgraph view(graph);
+	view.set_tree_arcs(parent);
+	return view.to_graph();
+}
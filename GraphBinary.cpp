@@ -0,0 +1,286 @@
+/*
+ * File:   GraphBinary.cpp
+ * Author: bret and daniel
+ *
+ * Binary snapshots of a graph.  A snapshot is a fixed header followed
+ * by the arrays of the graph, each starting on a 64-byte boundary, in
+ * the same form they have in memory:
+ *
+ *   arc offsets        int[n + 1]
+ *   arc targets        int[m]
+ *   arc weights        double[m]
+ *   node values        double[n]
+ *   node positions     double[2*n]  (x, y for each node, or nothing if
+ *                                    saved without the graphic stuff)
+ *   node names         int[n]       (the index of each node's name)
+ *   name offsets       uint64_t[names + 1]
+ *   name characters    char[...]
+ *   arc points         (int start, int end, double x, double y)[...]
+ *
+ * The header records where each array starts and how long it is, so
+ * later versions can add arrays.  Loading maps the file copy-on-write
+ * and points the graph's arrays into it, so a graph of any size is
+ * ready as soon as the header is checked; the pages are read from the
+ * file as they are first used.  The rows are packed, so the end of each
+ * row is the start of the next, and the row ends are the offsets array
+ * itself (shifted by one).  Only the node states and flags and the names
+ * and arc points get memory of their own: the states and flags are
+ * zeroed when they are first used, and the names and arc points (which
+ * are small) are copied in one piece.  (A snapshot saved without node
+ * positions is the exception: a graphical build puts every node at the
+ * origin when it loads one.)
+ *
+ * The numbers are stored in the machine's own format, so a snapshot can
+ * only be loaded on a machine with the same byte order (this is checked).
+ * Beyond the header, the arrays are trusted to be what 'save_binary'
+ * wrote.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+#include "Graph.h"
+#include "GraphParser.h"
+
+using namespace std;
+
+static const char SnapshotMagic[8] = { 'G', 'r', 'a', 'p', 'h', 'B', 'i', 'n' };
+static const uint32_t SnapshotVersion = 1;
+static const uint32_t ByteOrderMark = 0x01020304;
+
+// The arrays of a snapshot, in the order they are stored
+enum {
+	ArcOffsets, ArcTargets, ArcWeights, NodeValues, NodePositions,
+	NodeNames, NameOffsets, NameChars, ArcPoints, Sections
+};
+
+// Constants for the header 'flags'
+static const uint32_t SnapshotWeighted = 1 << 0;
+static const uint32_t SnapshotDirected = 1 << 1;
+
+struct SnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;        // 'ByteOrderMark', as the writer stored it
+	int64_t n;                  // number of nodes
+	int64_t m;                  // number of arcs
+	int64_t names;              // number of distinct names (with name 0)
+	int64_t arc_points;
+	uint32_t flags;
+	uint32_t unused;
+	double scale;
+	uint64_t start[Sections];   // where each array starts in the file
+	uint64_t bytes[Sections];   // and its length
+};
+
+// An arc point as it is stored
+struct SnapshotArcPoint {
+	int32_t start, end;
+	double x, y;
+};
+
+static uint64_t align_up(uint64_t offset)
+// Rounds 'offset' up to a whole number of 64-byte cache lines
+{
+	return (offset + 63) & ~(uint64_t)63;
+}
+
+bool Graph::save_binary(const string& filename) const
+// Writes this graph to 'filename' as a snapshot (see above).  Returns
+// false if the file can't be written.
+{
+	// (the arrays are saved with the rows packed)
+	if (arc_capacity != m) {
+		Graph packed(*this);
+		return packed.save_binary(filename);
+	}
+
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SnapshotMagic, sizeof(header.magic));
+	header.version = SnapshotVersion;
+	header.byte_order = ByteOrderMark;
+	header.n = n;
+	header.m = m;
+	header.names = name_count();
+	header.flags = (weighted ? SnapshotWeighted : 0)
+		| (directed ? SnapshotDirected : 0);
+
+	vector<SnapshotArcPoint> points;
+	const void *data[Sections];
+	data[ArcOffsets] = arc_offsets;
+	header.bytes[ArcOffsets] = (uint64_t)(n + 1)*sizeof(int);
+	data[ArcTargets] = arc_targets;
+	header.bytes[ArcTargets] = (uint64_t)m*sizeof(int);
+	data[ArcWeights] = arc_weights;
+	header.bytes[ArcWeights] = (uint64_t)m*sizeof(double);
+	data[NodeValues] = node_values;
+	header.bytes[NodeValues] = (uint64_t)n*sizeof(double);
+	data[NodePositions] = NULL;
+#ifdef GRAPHICAL
+	header.scale = scale;
+	data[NodePositions] = node_pos;
+	header.bytes[NodePositions] = (uint64_t)n*sizeof(PDFPoint);
+	for (size_t k = 0; k < arc_points.size(); k++) {
+		SnapshotArcPoint point = { arc_points[k].start, arc_points[k].end,
+			arc_points[k].p.x, arc_points[k].p.y };
+		points.push_back(point);
+	}
+	header.arc_points = (int64_t)points.size();
+#endif
+	data[NodeNames] = node_names;
+	header.bytes[NodeNames] = (uint64_t)n*sizeof(int);
+	data[NameOffsets] = name_offsets.data();
+	header.bytes[NameOffsets] = name_offsets.size()*sizeof(uint64_t);
+	data[NameChars] = name_chars.data();
+	header.bytes[NameChars] = name_chars.size();
+	data[ArcPoints] = points.data();
+	header.bytes[ArcPoints] = points.size()*sizeof(SnapshotArcPoint);
+
+	uint64_t offset = align_up(sizeof(header));
+	for (int s = 0; s < Sections; s++) {
+		header.start[s] = offset;
+		offset = align_up(offset + header.bytes[s]);
+	}
+
+	ofstream out(filename.c_str(), ios::binary);
+	if (!out) {
+		cerr << "Can't write to " << filename << endl;
+		return false;
+	}
+	out.write((const char *)&header, sizeof(header));
+	uint64_t written = sizeof(header);
+	static const char zeros[64] = { 0 };
+	for (int s = 0; s < Sections; s++) {
+		out.write(zeros, header.start[s] - written);
+		out.write((const char *)data[s], header.bytes[s]);
+		written = header.start[s] + header.bytes[s];
+	}
+	return (bool)out;
+}
+
+static void snapshot_error(const string& filename, const string& message)
+// Reports a problem with the snapshot in 'filename', and exits
+{
+	cerr << "snapshot '" << filename << "' " << message << endl;
+	exit(1);
+}
+
+Graph *Graph::load_binary(const string& filename)
+// Returns a new graph with the arrays of the snapshot in 'filename'
+{
+	MappedFile *file = new MappedFile(filename, MappedFile::CopyOnWrite);
+	if (!file->is_open()) {
+		cerr << "Can't read from " << filename << ".  Exiting.\n";
+		exit(1);
+	}
+
+	// check the header
+	if (file->size() < sizeof(SnapshotHeader)
+		|| memcmp(file->begin(), SnapshotMagic, sizeof(SnapshotMagic)) != 0)
+		snapshot_error(filename, "is not a Graph snapshot");
+	SnapshotHeader header;
+	memcpy(&header, file->begin(), sizeof(header));
+	if (header.byte_order != ByteOrderMark)
+		snapshot_error(filename, "was written on a machine with a different "
+			"byte order");
+	if (header.version != SnapshotVersion)
+		snapshot_error(filename, "is version " + to_string(header.version)
+			+ ", but only version " + to_string(SnapshotVersion)
+			+ " can be read");
+	if (header.n < 0 || header.n >= 0x7fffffff || header.m < 0
+		|| header.m > 0x7fffffff || header.names < 1 || header.arc_points < 0)
+		snapshot_error(filename, "has an impossible header");
+
+	uint64_t expected[Sections];
+	expected[ArcOffsets] = (uint64_t)(header.n + 1)*sizeof(int);
+	expected[ArcTargets] = (uint64_t)header.m*sizeof(int);
+	expected[ArcWeights] = (uint64_t)header.m*sizeof(double);
+	expected[NodeValues] = (uint64_t)header.n*sizeof(double);
+	expected[NodePositions] = (uint64_t)header.n*2*sizeof(double);
+	if (header.bytes[NodePositions] == 0)
+		expected[NodePositions] = 0;  // (saved without the graphic stuff)
+	expected[NodeNames] = (uint64_t)header.n*sizeof(int);
+	expected[NameOffsets] = (uint64_t)(header.names + 1)*sizeof(uint64_t);
+	expected[NameChars] = header.bytes[NameChars];
+	expected[ArcPoints] = (uint64_t)header.arc_points*sizeof(SnapshotArcPoint);
+	for (int s = 0; s < Sections; s++) {
+		if (header.bytes[s] != expected[s] || header.start[s] % 8 != 0
+			|| header.start[s] > file->size()
+			|| header.bytes[s] > file->size() - header.start[s])
+			snapshot_error(filename, "is cut short or damaged");
+	}
+	char *base = file->writable_begin();
+	const int n = (int)header.n;
+	const int m = (int)header.m;
+	const int *arc_offsets = (const int *)(base + header.start[ArcOffsets]);
+	if (arc_offsets[0] != 0 || arc_offsets[n] != m)
+		snapshot_error(filename, "has arc offsets that don't match its arcs");
+
+	// Start from an empty graph, and give it an arena for the arrays that
+	// aren't in the snapshot (the arena is not touched here, and the rest
+	// of it never is, so its pages are never actually allocated)
+	Graph *graph = new Graph();
+	graph->n = n;
+	graph->allocate_arrays(0);
+
+	graph->m = graph->arc_capacity = m;
+	graph->weighted = ((header.flags & SnapshotWeighted) != 0);
+	graph->directed = ((header.flags & SnapshotDirected) != 0);
+	graph->arc_offsets = (int *)(base + header.start[ArcOffsets]);
+	graph->arc_ends = graph->arc_offsets + 1;  // (until 'own_arrays')
+	graph->arc_targets = (int *)(base + header.start[ArcTargets]);
+	graph->arc_weights = (double *)(base + header.start[ArcWeights]);
+	graph->node_values = (double *)(base + header.start[NodeValues]);
+	graph->node_names = (int *)(base + header.start[NodeNames]);
+	graph->fields_stale = true;
+
+	const uint64_t *offsets = (const uint64_t *)(base + header.start[NameOffsets]);
+	const char *chars = base + header.start[NameChars];
+	graph->name_offsets.assign(offsets, offsets + header.names + 1);
+	graph->name_chars.assign(chars, chars + header.bytes[NameChars]);
+
+#ifdef GRAPHICAL
+	if (header.bytes[NodePositions] > 0) {
+		graph->scale = header.scale;
+		graph->node_pos = (PDFPoint *)(base + header.start[NodePositions]);
+	}
+	else {
+		// no positions were saved, so keep the arena's, at the origin
+		for (int i = 0; i < n; i++)
+			graph->node_pos[i] = PDFPoint(0, 0);
+	}
+	const SnapshotArcPoint *points =
+		(const SnapshotArcPoint *)(base + header.start[ArcPoints]);
+	for (int64_t k = 0; k < header.arc_points; k++) {
+		ArcPoint point = { points[k].start, points[k].end,
+			PDFPoint(points[k].x, points[k].y) };
+		graph->arc_points.push_back(point);
+	}
+#endif
+
+	graph->snapshot = file;
+	return graph;
+}
+
+void Graph::own_arrays()
+// If the arrays are in a snapshot, copies them to an arena of their own
+// (so they can be reallocated and freed like any others) and lets the
+// snapshot go
+{
+	if (!snapshot)
+		return;
+
+	const int *targets = arc_targets;
+	const double *weights = arc_weights;
+	free_arena(move_arrays(arc_capacity));
+	memcpy(arc_targets, targets, arc_capacity*sizeof(int));
+	memcpy(arc_weights, weights, arc_capacity*sizeof(double));
+
+	delete snapshot;
+	snapshot = NULL;
+}
@@ -0,0 +1,507 @@
+/*
+ * File:   GraphImport.cpp
+ * Author: bret and daniel
+ *
+ * The importers of 'GraphParser' for the edge list, DIMACS, METIS, and
+ * Matrix Market formats (see "GraphParser.h").
+ */
+
+#include <cstring>
+#include <cctype>
+#include <climits>
+#include <algorithm>
+
+#include "GraphParser.h"
+
+using namespace std;
+
+// (in "Graph.cpp")
+extern bool Verbose;
+bool check_arc_indices(int start, int end, int n_nodes,
+	const string& source_name, int line_num);
+
+static bool starts_with(const char *p, const char *end, const char *prefix)
+// True if the text from 'p' to 'end' starts with 'prefix'
+{
+	size_t length = strlen(prefix);
+	return (size_t)(end - p) >= length && memcmp(p, prefix, length) == 0;
+}
+
+static bool has_extension(const string& filename, const char *extension)
+// True if 'filename' ends with 'extension' (in any case)
+{
+	size_t length = strlen(extension);
+	if (filename.size() < length)
+		return false;
+	for (size_t k = 0; k < length; k++) {
+		if (tolower((unsigned char)filename[filename.size() - length + k])
+			!= extension[k])
+			return false;
+	}
+	return true;
+}
+
+GraphParser::Format GraphParser::detect_format(const string& filename,
+	const char *begin, const char *end)
+// Picks the format from the first bytes of the text where they tell
+// (the "Graph" and "%%MatrixMarket" headers, and DIMACS "c" and "p"
+// lines), then from the extension of 'filename', and then takes lines
+// of numbers or '#' comments to be an edge list
+{
+	const char *p = begin;
+	while (p < end && (unsigned char)*p <= ' ')
+		p++;
+	if (starts_with(p, end, "Graph")
+		&& (p + 5 == end || (unsigned char)p[5] <= ' '))
+		return GraphText;
+	if (starts_with(p, end, "%%MatrixMarket"))
+		return MatrixMarket;
+
+	if (has_extension(filename, ".gr"))
+		return Dimacs;
+	if (has_extension(filename, ".mtx"))
+		return MatrixMarket;
+	if (has_extension(filename, ".graph") || has_extension(filename, ".metis"))
+		return Metis;
+
+	if (p < end && (*p == 'c' || *p == 'p')
+		&& (p + 1 == end || (unsigned char)p[1] <= ' '))
+		return Dimacs;
+	if (p < end && (*p == '#' || (*p >= '0' && *p <= '9')))
+		return EdgeList;
+	return GraphText;
+}
+
+void GraphParser::import(Graph& g, Format format)
+// Reads the text into 'g' in two passes: the first checks it and counts
+// the arcs of each node, and the second stores them in place
+{
+	graph = &g;
+	const char *begin = p;
+	int first_line = line_num;
+
+	filling = false;
+	scan_edges(format);
+	if (arc_total > INT_MAX) {
+		cerr << source_name << " error: too many arcs (" << arc_total << ")\n";
+		exit(1);
+	}
+
+	// Size the arc arrays, and turn the counts into where each row starts
+	graph->init(n_nodes, (int)arc_total);
+	graph->m = (int)arc_total;
+	row_counts.resize(n_nodes, 0);
+	int offset = 0;
+	for (int i = 0; i < n_nodes; i++) {
+		graph->arc_offsets[i] = offset;
+		offset += row_counts[i];
+		row_counts[i] = graph->arc_offsets[i];
+	}
+	graph->arc_offsets[n_nodes] = offset;
+
+	p = begin;
+	line_num = first_line;
+	filling = true;
+	scan_edges(format);
+	sort_rows();
+
+	graph->weighted = weighted_arcs;
+	graph->directed = !undirected;
+	if (Verbose)
+		cout << "read " << graph->n << " nodes and " << graph->m << " arcs\n";
+}
+
+void GraphParser::scan_edges(Format format)
+// Reads the text once in 'format'
+{
+	switch (format) {
+	case EdgeList:
+		scan_edge_list();
+		break;
+	case Dimacs:
+		scan_dimacs();
+		break;
+	case Metis:
+		scan_metis();
+		break;
+	case MatrixMarket:
+		scan_matrix_market();
+		break;
+	default:
+		break;
+	}
+}
+
+void GraphParser::add_edge(int start, int end, double weight)
+// Counts the arc start->end in the first pass, and stores it in the
+// second, along with end->start if edges are mirrored.  The indices
+// start at 0, and are checked by the caller.
+{
+	if (!filling) {
+		row_counts[start]++;
+		arc_total++;
+		if (mirror_edges && start != end) {
+			row_counts[end]++;
+			arc_total++;
+		}
+		return;
+	}
+
+	int a = row_counts[start]++;
+	graph->arc_targets[a] = end;
+	graph->arc_weights[a] = weight;
+	if (mirror_edges && start != end) {
+		a = row_counts[end]++;
+		graph->arc_targets[a] = start;
+		graph->arc_weights[a] = weight;
+	}
+}
+
+static bool target_before(const pair<int, double>& a, const pair<int, double>& b)
+{
+	return a.first < b.first;
+}
+
+void GraphParser::sort_rows()
+// Sorts each row of the stored arcs by end node, as the arc arrays
+// require, and drops all but the last of each run of duplicate arcs
+// (as 'build_arcs' does).  Most files list the arcs in order already,
+// so a row is only sorted if it has to be.
+{
+	int *offsets = graph->arc_offsets;
+	int *targets = graph->arc_targets;
+	double *weights = graph->arc_weights;
+	vector< pair<int, double> > row;
+	int count = 0;
+	int first = 0;
+	for (int i = 0; i < n_nodes; i++) {
+		int last = offsets[i + 1];
+		offsets[i] = count;
+
+		bool ascending = true;
+		for (int a = first + 1; a < last && ascending; a++)
+			ascending = (targets[a - 1] < targets[a]);
+		if (ascending) {
+			if (count != first) {
+				memmove(targets + count, targets + first,
+					(last - first)*sizeof(int));
+				memmove(weights + count, weights + first,
+					(last - first)*sizeof(double));
+			}
+			count += last - first;
+		}
+		else {
+			row.clear();
+			for (int a = first; a < last; a++)
+				row.push_back(make_pair(targets[a], weights[a]));
+			stable_sort(row.begin(), row.end(), target_before);
+			for (size_t k = 0; k < row.size(); k++) {
+				if (k + 1 < row.size() && row[k + 1].first == row[k].first)
+					continue;
+				targets[count] = row[k].first;
+				weights[count] = row[k].second;
+				count++;
+			}
+		}
+		first = last;
+	}
+	offsets[n_nodes] = count;
+	graph->m = graph->arc_capacity = count;
+	graph->set_row_ends();
+}
+
+void GraphParser::scan_edge_list()
+//   # <comment>
+//   <start-id> <end-id> [<weight>]
+//
+// In the first pass the ids are read on their own before the arcs are
+// counted, since the nodes can't be numbered until all the ids are seen
+{
+	if (!filling) {
+		const char *begin = p;
+		int first_line = line_num;
+		scan_edge_lines(true);
+		number_edge_ids();
+		p = begin;
+		line_num = first_line;
+	}
+	else {
+		// nodes numbered from sparse ids are named by them
+		for (size_t i = 0; i < sparse_ids.size(); i++)
+			graph->node_names[i] = graph->add_name(to_string(sparse_ids[i]));
+	}
+	scan_edge_lines(false);
+}
+
+void GraphParser::scan_edge_lines(bool ids_only)
+// Reads the lines of an edge list once, marking the ids of the edges in
+// 'id_bits' if 'ids_only', and passing the edges to 'add_edge' otherwise
+{
+	bool any_edges = false;
+	for (;;) {
+		skip_spaces();
+		if (p == end)
+			break;
+		if (*p == '#' || *p == '%') {
+			// a comment; "Undirected" in one before the first edge (as
+			// in the SNAP headers) means each edge goes both ways
+			string_view comment = get_rest();
+			if (ids_only && !any_edges
+				&& comment.find("Undirected") != string_view::npos)
+				mirror_edges = undirected = true;
+		}
+		else if (*p != '\n') {
+			int start_id = get_int();
+			int end_id = get_int();
+			double weight = 1;
+			skip_spaces();
+			if (p < end && *p != '\n') {
+				weight = get_double();
+				weighted_arcs = true;
+			}
+			if (start_id < 0 || end_id < 0 || start_id == INT_MAX
+				|| end_id == INT_MAX)
+				error("invalid node id");
+			if (!(weight > 0))
+				error("arc weight must be positive");
+			any_edges = true;
+			if (ids_only) {
+				mark_id(start_id);
+				mark_id(end_id);
+			}
+			else
+				add_edge(node_of_id(start_id), node_of_id(end_id), weight);
+		}
+		skip_line();
+	}
+}
+
+void GraphParser::mark_id(int id)
+// Records that edge list id 'id' is used
+{
+	size_t word = (size_t)id >> 6;
+	if (word >= id_bits.size())
+		id_bits.resize(max(word + 1, 2*id_bits.size()), 0);
+	id_bits[word] |= (uint64_t)1 << (id & 63);
+	max_id = max(max_id, id);
+}
+
+void GraphParser::number_edge_ids()
+// Numbers the nodes of an edge list from the ids marked in 'id_bits'.
+// Id 'k' is node k if the ids are dense enough; if most of the ids up
+// to the largest are unused (as with hashed ids), the distinct ids are
+// numbered in order instead, so the graph only has nodes that are used.
+{
+	long long distinct = 0;
+	for (size_t w = 0; w < id_bits.size(); w++)
+		distinct += bit_count(id_bits[w]);
+	if (max_id < 2*distinct)
+		n_nodes = max_id + 1;
+	else {
+		sparse_ids.reserve(distinct);
+		for (size_t w = 0; w < id_bits.size(); w++)
+			for (uint64_t bits = id_bits[w]; bits != 0; bits &= bits - 1)
+				sparse_ids.push_back((int)(w*64 + lowest_bit(bits)));
+		n_nodes = (int)sparse_ids.size();
+	}
+	vector<uint64_t>().swap(id_bits);
+	row_counts.assign(n_nodes, 0);
+}
+
+int GraphParser::node_of_id(int id) const
+// The index of the node with edge list id 'id' (which was marked in the
+// first pass)
+{
+	if (sparse_ids.empty())
+		return id;
+	return (int)(lower_bound(sparse_ids.begin(), sparse_ids.end(), id)
+		- sparse_ids.begin());
+}
+
+void GraphParser::scan_dimacs()
+//   c <comment>
+//   p sp <nodes> <arcs>
+//   a <start-index> <end-index> <weight>
+{
+	bool have_problem = false;
+	weighted_arcs = true;
+	for (;;) {
+		skip_spaces();
+		if (p == end)
+			break;
+		string_view key = get_token();
+		if (key.empty() || key == "c") {
+			// a blank line or a comment
+		}
+		else if (key == "a") {
+			if (!have_problem)
+				error("arc before the \"p\" line");
+			int start_i = get_int();
+			int end_i = get_int();
+			double weight = get_double();
+			if (!check_arc_indices(start_i, end_i, n_nodes, source_name, line_num))
+				exit(1);
+			if (!(weight > 0))
+				error("arc weight must be positive");
+			add_edge(start_i - 1, end_i - 1, weight);
+		}
+		else if (key == "p") {
+			if (have_problem)
+				error("more than one \"p\" line");
+			get_token();  // (the problem type, normally "sp")
+			n_nodes = get_int();
+			get_int();    // (the number of arcs, which are counted instead)
+			if (n_nodes < 0)
+				error("the number of nodes can't be negative");
+			if (!filling)
+				row_counts.assign(n_nodes, 0);
+			have_problem = true;
+		}
+		else if (!filling)
+			cerr << source_name << ":" << line_num
+				<< " unknown line type '" << key << "'\n";
+		skip_line();
+	}
+	if (!have_problem) {
+		cerr << "input source '" << source_name
+			<< "' has no DIMACS \"p\" line\n";
+		exit(1);
+	}
+}
+
+void GraphParser::scan_metis()
+//   % <comment>
+//   <nodes> <edges> [<fmt> [<ncon>]]
+//   [<size>] [<node-weight> ...] <neighbor> [<edge-weight>] ...
+//
+// There is one line for each node after the header, in order, and a
+// blank line is a node with no neighbors.  The digits of 'fmt' say
+// whether the lines have sizes, node weights ('ncon' of them, or 1),
+// and edge weights, in that order.
+{
+	// skip the comments before the header
+	for (;;) {
+		skip_spaces();
+		if (p == end || *p != '%')
+			break;
+		skip_line();
+	}
+	n_nodes = get_int();
+	get_int();  // (the number of edges, which are counted instead)
+	if (n_nodes < 0)
+		error("the number of nodes can't be negative");
+	bool sizes = false, node_weights = false, edge_weights = false;
+	int ncon = 1;
+	skip_spaces();
+	if (p < end && *p != '\n') {
+		string_view fmt = get_token();
+		if (fmt.size() > 3 || fmt.find_first_not_of("01") != string_view::npos)
+			error("invalid format '" + string(fmt) + "'");
+		size_t k = fmt.size();
+		edge_weights = (k >= 1 && fmt[k - 1] == '1');
+		node_weights = (k >= 2 && fmt[k - 2] == '1');
+		sizes = (k >= 3 && fmt[k - 3] == '1');
+		skip_spaces();
+		if (p < end && *p != '\n')
+			ncon = get_int();
+		if (ncon < 1)
+			error("the number of node weights must be positive");
+	}
+	skip_line();
+	if (!filling)
+		row_counts.assign(n_nodes, 0);
+	weighted_arcs = edge_weights;
+
+	// (the lists already name each edge from both ends)
+	undirected = true;
+	for (int i = 0; i < n_nodes; i++) {
+		while (p < end && *p == '%')
+			skip_line();
+		if (p == end)
+			error("expected " + to_string(n_nodes) + " node lines");
+		if (sizes)
+			get_int();
+		if (node_weights) {
+			for (int c = 0; c < ncon; c++) {
+				double weight = get_double();
+				if (c == 0 && filling)
+					graph->node_values[i] = weight;
+			}
+		}
+		for (;;) {
+			skip_spaces();
+			if (p == end || *p == '\n')
+				break;
+			int neighbor = get_int();
+			double weight = (edge_weights ? get_double() : 1);
+			if (!check_arc_indices(i + 1, neighbor, n_nodes, source_name,
+				line_num))
+				exit(1);
+			if (!(weight > 0))
+				error("edge weight must be positive");
+			add_edge(i, neighbor - 1, weight);
+		}
+		skip_line();
+	}
+}
+
+void GraphParser::scan_matrix_market()
+//   %%MatrixMarket matrix coordinate <field> <symmetry>
+//   % <comment>
+//   <rows> <columns> <entries>
+//   <row> <column> [<value>]
+{
+	if (get_token() != "%%MatrixMarket" || get_token() != "matrix")
+		error("expected a \"%%MatrixMarket matrix\" header");
+	if (get_token() != "coordinate")
+		error("only coordinate matrices can be read");
+	string_view field = get_token();
+	string_view symmetry = get_token();
+	if (field != "real" && field != "integer" && field != "pattern")
+		error("unsupported field '" + string(field) + "'");
+	if (symmetry == "symmetric")
+		mirror_edges = undirected = true;
+	else if (symmetry != "general")
+		error("unsupported symmetry '" + string(symmetry) + "'");
+	weighted_arcs = (field != "pattern");
+	skip_line();
+
+	for (;;) {
+		skip_spaces();
+		if (p == end || (*p != '%' && *p != '\n'))
+			break;
+		skip_line();
+	}
+	int rows = get_int();
+	int columns = get_int();
+	int entries = get_int();
+	if (rows < 0 || columns < 0 || entries < 0)
+		error("the matrix size can't be negative");
+	n_nodes = max(rows, columns);
+	if (!filling)
+		row_counts.assign(n_nodes, 0);
+	skip_line();
+
+	int count = 0;
+	for (;;) {
+		skip_spaces();
+		if (p == end)
+			break;
+		if (*p != '%' && *p != '\n') {
+			int row = get_int();
+			int column = get_int();
+			double value = (weighted_arcs ? get_double() : 1);
+			if (row <= 0 || row > rows || column <= 0 || column > columns)
+				error("entry (" + to_string(row) + ", " + to_string(column)
+					+ ") is outside the matrix");
+			if (!(value > 0))
+				error("arc weight must be positive");
+			add_edge(row - 1, column - 1, value);
+			count++;
+		}
+		skip_line();
+	}
+	if (count != entries)
+		error("expected " + to_string(entries) + " entries, found "
+			+ to_string(count));
+}
@@ -0,0 +1,485 @@
+/*
+ * File:   GraphParallel.cpp
+ * Author: bret and daniel
+ *
+ * Multi-threaded graph algorithms.
+ */
+
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+#include "Graph.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Work lists are handed out to the threads this many nodes at a time
+static const int ChunkSize = 64;
+
+static void for_each_chunk(ThreadPool& pool, size_t count,
+	const function<void(int, size_t, size_t)>& body)
+// Runs 'body(t, first, last)' on the threads of 'pool' for chunks
+// [first, last) of 0..count-1.  The chunks are taken from a shared
+// counter, so threads that get cheap nodes come back for more.
+{
+	atomic<size_t> next_chunk(0);
+	pool.run([&](int t) {
+		for (;;)
+		{
+			size_t first = next_chunk.fetch_add(ChunkSize);
+			if (first >= count)
+				break;
+			size_t last = first + ChunkSize;
+			body(t, first, (last < count ? last : count));
+		}
+	});
+}
+
+static void for_each_item(ThreadPool& pool, int count,
+	const function<void(int)>& body)
+// Runs 'body(k)' for k = 0..count-1 on the threads of 'pool', one item
+// at a time (for a few large items)
+{
+	atomic<int> next_item(0);
+	pool.run([&](int) {
+		for (int k = next_item++; k < count; k = next_item++)
+			body(k);
+	});
+}
+
+//-----------------------------------------------------------------------------
+//	Function: void parallel_breadth_first( int start_i, vector<int>& parent,
+//                                         ThreadPool& pool, vector<int> *level )
+//  
+//	Title:	Graph
+//
+//	Description:
+//				a level-synchronous breadth-first traversal on the threads
+//     of 'pool'.  Each level is one parallel phase: the threads take
+//     chunks of the frontier, and claim each unvisited node they reach by
+//     a compare-and-swap on its parent entry, so exactly one thread
+//     discovers it.  Each thread collects the nodes it claims in its own
+//     buffer; a second phase copies the buffers into the next frontier at
+//     offsets found by a prefix sum, so no lock is ever taken.
+//
+//     The levels are the same as for 'breadth_first', and the parents
+//     form a valid breadth-first tree.  Which of several frontier nodes
+//     becomes a node's parent depends on the thread timing.
+//
+//  Returns: N/A ('parent' holds the breadth-first spanning tree)
+//
+//  Parameters: int representing the node from which to start traversing,
+//     the parent array to fill in, the thread pool, and optionally an
+//     array for the level (hop distance) of each node (-1 if unreached)
+//
+//-----------------------------------------------------------------------------
+void Graph::parallel_breadth_first(int start_i, vector<int>& parent,
+	ThreadPool& pool, vector<int> *level)
+{
+	const int threads = pool.size();
+	if (!check_index(start_i, n, "parallel_breadth_first()")) {
+		parent.assign(n, -1);
+		if (level)
+			level->assign(n, -1);
+		return;
+	}
+
+	// 'claim[v]' is -1 until some thread discovers 'v' and stores the
+	// node it came from (the start node claims itself)
+	vector< atomic<int> > claim(n);
+	for (int v = 0; v < n; v++)
+		claim[v].store(-1, memory_order_relaxed);
+	claim[start_i].store(start_i, memory_order_relaxed);
+	if (level)
+		level->assign(n, -1);
+
+	vector<int> frontier(1, start_i), next;
+	vector< vector<int> > found(threads);
+	vector<size_t> offset(threads + 1);
+
+	for (int depth = 1; !frontier.empty(); depth++)
+	{
+		// Phase 1: expand the frontier into the per-thread buffers
+		for (int t = 0; t < threads; t++)
+			found[t].clear();
+		for_each_chunk(pool, frontier.size(),
+			[&](int t, size_t first, size_t last) {
+			for (size_t f = first; f < last; f++)
+			{
+				int u = frontier[f];
+				for (int a = first_arc(u); a < last_arc(u); a++)
+				{
+					int v = arc_target(a);
+					// skip the compare-and-swap if 'v' is already taken
+					if (claim[v].load(memory_order_relaxed) != -1)
+						continue;
+					int unclaimed = -1;
+					if (claim[v].compare_exchange_strong(unclaimed, u,
+							memory_order_relaxed))
+						found[t].push_back(v);
+				}
+			}
+		});
+
+		// Phase 2: concatenate the buffers to form the next frontier
+		offset[0] = 0;
+		for (int t = 0; t < threads; t++)
+			offset[t + 1] = offset[t] + found[t].size();
+		next.resize(offset[threads]);
+		pool.run([&](int t) {
+			copy(found[t].begin(), found[t].end(), next.begin() + offset[t]);
+			if (level)
+				for (size_t k = 0; k < found[t].size(); k++)
+					(*level)[found[t][k]] = depth;
+		});
+
+		frontier.swap(next);
+	}
+
+	// copy out the tree, and mark the reached nodes
+	parent.assign(n, -1);
+	set_all_node_states(0);
+	for (int v = 0; v < n; v++)
+	{
+		int p = claim[v].load(memory_order_relaxed);
+		if (p != -1)
+		{
+			node_states[v] = Visited;
+			parent[v] = (v == start_i ? -1 : p);
+		}
+	}
+	if (level)
+		(*level)[start_i] = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+//	Function: double delta_stepping_width()
+//  
+//	Title:	Graph
+//
+//	Description:
+//				picks the bucket width for 'parallel_shortest_paths' from
+//     the arc weights: the largest weight divided by the average out-degree,
+//     kept between the smallest and largest weight.  Wider buckets mean
+//     more parallel work per phase but more relaxations that are later
+//     undone; this balances the two for the usual random-weight graphs.
+//     (For unweighted graphs it is 1, which makes each bucket a level.)
+//
+//  Returns: the bucket width
+//
+//  Parameters: N/A
+//
+//-----------------------------------------------------------------------------
+double Graph::delta_stepping_width() const
+{
+	if (m == 0)
+		return 1;
+
+	double min_w = InfiniteDistance, max_w = 0;
+	for (int i = 0; i < n; i++)
+	{
+		for (int a = first_arc(i); a < last_arc(i); a++)
+		{
+			if (arc_weights[a] < min_w)
+				min_w = arc_weights[a];
+			if (arc_weights[a] > max_w)
+				max_w = arc_weights[a];
+		}
+	}
+
+	double delta = max_w / ((double)m / n);
+	if (delta < min_w)
+		delta = min_w;
+	if (delta > max_w)
+		delta = max_w;
+	return delta;
+}
+
+
+// A relaxation request: node 'v' can be reached at distance 'dist' from 'u'
+struct Relaxation {
+	int v;
+	int u;
+	double dist;
+};
+
+//-----------------------------------------------------------------------------
+//	Function: void parallel_shortest_paths( int source_i, vector<double>& dist,
+//                                          vector<int>& parent,
+//                                          ThreadPool& pool, double delta )
+//  
+//	Title:	Graph
+//
+//	Description:
+//				single-source shortest paths by delta-stepping (Meyer and
+//     Sanders) on the threads of 'pool'.  Nodes wait in buckets of width
+//     'delta' by tentative distance.  The lowest nonempty bucket is
+//     emptied repeatedly, relaxing the "light" arcs (weight <= delta) of
+//     its nodes, which may refill it; once it stays empty the "heavy" arcs
+//     of every node removed from it are relaxed once.  All the nodes of a
+//     bucket are relaxed in parallel.
+//
+//     Each relaxation phase has two parallel steps: the threads turn
+//     chunks of the work list into requests (v, u, d), sorted into one
+//     list per owner thread (v mod threads); then each owner applies the
+//     requests for its own nodes.  So only one thread ever writes a
+//     given 'dist[v]', and no locks or atomics are needed on it.
+//
+//     The distances are the same as for 'shortest_paths', and the
+//     parents form a valid shortest path tree.
+//
+//  Returns: N/A ('dist' holds the distances, and 'parent' the shortest
+//     path tree)
+//
+//  Parameters: int representing the source node, the arrays to fill in,
+//     the thread pool, and the bucket width (<= 0 to choose it with
+//     'delta_stepping_width')
+//
+//-----------------------------------------------------------------------------
+void Graph::parallel_shortest_paths(int source_i, vector<double>& dist,
+	vector<int>& parent, ThreadPool& pool, double delta)
+{
+	const int threads = pool.size();
+	if (delta <= 0)
+		delta = delta_stepping_width();
+
+	dist.assign(n, InfiniteDistance);
+	parent.assign(n, -1);
+	if (!check_index(source_i, n, "parallel_shortest_paths()"))
+		return;
+
+	// Every tentative distance lies within the largest weight of the
+	// current bucket, so the buckets can be reused cyclically
+	double max_w = 0;
+	for (int i = 0; i < n; i++)
+		for (int a = first_arc(i); a < last_arc(i); a++)
+			if (arc_weights[a] > max_w)
+				max_w = arc_weights[a];
+	const long n_buckets = (long)(max_w / delta) + 2;
+	vector< vector<int> > buckets(n_buckets);
+	long pending = 0;  // entries in all the buckets (some may be stale)
+
+	// requests[t][o] holds the requests made by thread 't' for nodes
+	// owned by thread 'o'; moved[o] lists the nodes 'o' improved
+	vector< vector< vector<Relaxation> > > requests(threads,
+		vector< vector<Relaxation> >(threads));
+	vector< vector<int> > moved(threads);
+
+	// 'seen' stamps dedupe the work lists
+	vector<long> seen(n, -1);
+	long stamp = 0;
+
+	dist[source_i] = 0;
+	buckets[0].push_back(source_i);
+	pending = 1;
+
+	// Relaxes the light or heavy arcs of the nodes in 'work' in parallel,
+	// and files each improved node in its new bucket
+	auto relax = [&](const vector<int>& work, bool light) {
+		for_each_chunk(pool, work.size(),
+			[&](int t, size_t first, size_t last) {
+			for (size_t k = first; k < last; k++)
+			{
+				int u = work[k];
+				for (int a = first_arc(u); a < last_arc(u); a++)
+				{
+					double w = arc_weights[a];
+					if ((w <= delta) != light)
+						continue;
+					int v = arc_targets[a];
+					double d = dist[u] + w;
+					if (d < dist[v])
+					{
+						Relaxation r = { v, u, d };
+						requests[t][v % threads].push_back(r);
+					}
+				}
+			}
+		});
+
+		pool.run([&](int o) {
+			moved[o].clear();
+			for (int t = 0; t < threads; t++)
+			{
+				vector<Relaxation>& mine = requests[t][o];
+				for (size_t k = 0; k < mine.size(); k++)
+				{
+					const Relaxation& r = mine[k];
+					if (r.dist < dist[r.v])
+					{
+						dist[r.v] = r.dist;
+						parent[r.v] = r.u;
+						moved[o].push_back(r.v);
+					}
+				}
+				mine.clear();
+			}
+		});
+
+		for (int o = 0; o < threads; o++)
+			for (size_t k = 0; k < moved[o].size(); k++)
+			{
+				int v = moved[o][k];
+				buckets[(long)(dist[v] / delta) % n_buckets].push_back(v);
+				pending++;
+			}
+	};
+
+	vector<int> current, removed;
+	for (long b = 0; pending > 0; b++)
+	{
+		vector<int>& bucket = buckets[b % n_buckets];
+		removed.clear();
+		long removed_stamp = stamp++;
+
+		while (!bucket.empty())
+		{
+			// take the bucket's current nodes, dropping stale entries
+			// (nodes that have since moved to a lower bucket) and repeats
+			current.clear();
+			long current_stamp = stamp++;
+			pending -= bucket.size();
+			for (size_t k = 0; k < bucket.size(); k++)
+			{
+				int v = bucket[k];
+				if ((long)(dist[v] / delta) != b || seen[v] == current_stamp)
+					continue;
+				seen[v] = current_stamp;
+				current.push_back(v);
+			}
+			bucket.clear();
+
+			relax(current, true);
+
+			// remember the removed nodes for their heavy arcs
+			for (size_t k = 0; k < current.size(); k++)
+				removed.push_back(current[k]);
+		}
+
+		// each removed node's heavy arcs are relaxed once
+		current.clear();
+		for (size_t k = 0; k < removed.size(); k++)
+			if (seen[removed[k]] != removed_stamp)
+			{
+				seen[removed[k]] = removed_stamp;
+				current.push_back(removed[k]);
+			}
+		relax(current, false);
+	}
+
+	// mark the reached nodes
+	set_all_node_states(0);
+	for (int v = 0; v < n; v++)
+		if (dist[v] != InfiniteDistance)
+			node_states[v] = Visited;
+}
+
+
+//-----------------------------------------------------------------------------
+//	Function: void build_arcs( vector< vector<ArcRecord> >& parts,
+//                             ThreadPool& pool )
+//  
+//	Title:	Graph
+//
+//	Description:
+//				replaces all the arcs of this graph with those in 'parts',
+//     taken in order as one list (as for the one-list 'build_arcs', if an
+//     arc appears more than once, the last one wins).  The rows are split
+//     into a few ranges per thread.  The parts are counted by range and
+//     then scattered into one array grouped by range, each part to its
+//     own place, so the order of the arcs within a range is kept.  Each
+//     range is then sorted, and copied into the arc arrays, on its own.
+//     The parts are emptied.
+//
+//  Returns: N/A
+//
+//  Parameters: the lists of arcs, and the thread pool
+//
+//-----------------------------------------------------------------------------
+void Graph::build_arcs(vector< vector<ArcRecord> >& parts, ThreadPool& pool)
+{
+	own_arrays();
+	const int n_parts = (int)parts.size();
+	int ranges = 4*pool.size();
+	if (ranges > n)
+		ranges = (n > 0 ? n : 1);
+
+	// range 'r' holds rows range_row[r] .. range_row[r + 1] - 1
+	vector<int> range_row(ranges + 1);
+	for (int r = 0; r <= ranges; r++)
+		range_row[r] = (int)(((long long)r*n + ranges - 1) / ranges);
+
+	// count the arcs of each part in each range
+	vector<size_t> place((size_t)n_parts*ranges, 0);
+	for_each_item(pool, n_parts, [&](int k) {
+		size_t *count = &place[(size_t)k*ranges];
+		for (size_t a = 0; a < parts[k].size(); a++)
+			count[(long long)parts[k][a].start*ranges / n]++;
+	});
+
+	// lay the ranges out one after another, and within each range the
+	// parts in order; 'place' becomes where each part's arcs go
+	vector<size_t> range_start(ranges + 1);
+	size_t total = 0;
+	for (int r = 0; r < ranges; r++) {
+		range_start[r] = total;
+		for (int k = 0; k < n_parts; k++) {
+			size_t count = place[(size_t)k*ranges + r];
+			place[(size_t)k*ranges + r] = total;
+			total += count;
+		}
+	}
+	range_start[ranges] = total;
+
+	vector<ArcRecord> arcs(total);
+	for_each_item(pool, n_parts, [&](int k) {
+		size_t *next = &place[(size_t)k*ranges];
+		for (size_t a = 0; a < parts[k].size(); a++)
+			arcs[next[(long long)parts[k][a].start*ranges / n]++] = parts[k][a];
+		vector<ArcRecord>().swap(parts[k]);
+	});
+
+	// sort each range, keeping the last of each run of duplicates
+	vector<size_t> kept(ranges + 1, 0);
+	for_each_item(pool, ranges, [&](int r) {
+		vector<ArcRecord>::iterator first = arcs.begin() + range_start[r];
+		vector<ArcRecord>::iterator last = arcs.begin() + range_start[r + 1];
+		stable_sort(first, last);
+		size_t count = 0;
+		for (vector<ArcRecord>::iterator a = first; a != last; ++a) {
+			if (a + 1 != last && (a + 1)->start == a->start
+				&& (a + 1)->end == a->end)
+				continue;
+			first[count++] = *a;
+		}
+		kept[r + 1] = count;
+	});
+	for (int r = 0; r < ranges; r++)
+		kept[r + 1] += kept[r];
+
+	// (the old arcs aren't needed)
+	free_arena(move_arrays((int)kept[ranges]));
+	m = arc_capacity = (int)kept[ranges];
+
+	// fill the rows of each range
+	for_each_item(pool, ranges, [&](int r) {
+		const ArcRecord *range_arcs = arcs.data() + range_start[r];
+		int a = (int)kept[r];
+		for (int i = range_row[r]; i < range_row[r + 1]; i++) {
+			arc_offsets[i] = a;
+			while (a < (int)kept[r + 1] && range_arcs[a - kept[r]].start == i) {
+				arc_targets[a] = range_arcs[a - kept[r]].end;
+				arc_weights[a] = range_arcs[a - kept[r]].weight;
+				a++;
+			}
+		}
+	});
+	arc_offsets[n] = m;
+	set_row_ends();
+	in_valid = false;
+	bits_valid = false;
+	astar_ratio = -1;
+}
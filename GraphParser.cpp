@@ -0,0 +1,596 @@
+/*
+ * File:   GraphParser.cpp
+ * Author: bret and daniel
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <charconv>
+#include <atomic>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define HAVE_MMAP
+#endif
+
+#include "GraphParser.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// (in "Graph.cpp")
+extern bool Verbose;
+bool check_node_index(int index, int n_nodes,
+	const string& source_name, int line_num);
+bool check_arc_indices(int start, int end, int n_nodes,
+	const string& source_name, int line_num);
+
+/**************/
+/* MappedFile */
+/**************/
+
+MappedFile::MappedFile(const string& filename, Access access)
+	: ok(false), mapped(false), access(access), data(NULL), length(0)
+// Maps 'filename' into memory if possible, and reads it in otherwise
+{
+#ifdef HAVE_MMAP
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		length = (size_t)st.st_size;
+		if (length == 0) {
+			// (an empty file can't be mapped, but it can be read)
+			close(fd);
+			data = new char[1];
+			ok = true;
+			return;
+		}
+		int protection = (access == CopyOnWrite ? PROT_READ | PROT_WRITE
+			: PROT_READ);
+		void *m = mmap(NULL, length, protection, MAP_PRIVATE, fd, 0);
+		if (m != MAP_FAILED) {
+			if (access == Sequential)
+				madvise(m, length, MADV_SEQUENTIAL);
+			data = (char *)m;
+			mapped = ok = true;
+			close(fd);
+			return;
+		}
+	}
+	close(fd);
+#endif
+
+	// Read the whole file into one buffer instead
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return;
+	vector<char> contents;
+	const size_t Block = 1 << 20;
+	size_t got;
+	do {
+		contents.resize(length + Block);
+		got = fread(contents.data() + length, 1, Block, file);
+		length += got;
+	} while (got == Block);
+	fclose(file);
+
+	data = new char[length + 1];
+	memcpy(data, contents.data(), length);
+	ok = true;
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef HAVE_MMAP
+	if (mapped) {
+		munmap((void *)data, length);
+		return;
+	}
+#endif
+	delete[] data;
+}
+
+
+/***************/
+/* GraphParser */
+/***************/
+
+static inline bool is_space(char c)
+// True for the whitespace characters within a line (any control
+// character other than the newline counts as whitespace)
+{
+	return (unsigned char)c <= ' ' && c != '\n';
+}
+
+static inline bool ends_token(char c)
+// True for the characters that end a token: whitespace or the newline
+{
+	return (unsigned char)c <= ' ';
+}
+
+GraphParser::GraphParser(const char *begin, const char *end,
+	const string& source_name)
+	: p(begin), end(end), source_name(source_name), line_num(1),
+	graph(NULL), n_nodes(0), node_count(0), weighted_arcs(false),
+	filling(false), mirror_edges(false), undirected(false), arc_total(0),
+	max_id(-1)
+{
+}
+
+void GraphParser::error(const string& message) const
+// Reports an error on the current line, and exits
+{
+	cerr << source_name << ":" << line_num << " error: " << message << endl;
+	exit(1);
+}
+
+void GraphParser::skip_spaces()
+// Skips over whitespace up to the end of the line
+{
+	while (p < end && is_space(*p))
+		p++;
+}
+
+const char *GraphParser::line_end() const
+// Returns where the current line ends: its newline, or the end of text
+{
+	if (p >= end)
+		return end;
+	const char *newline = (const char *)memchr(p, '\n', end - p);
+	return (newline ? newline : end);
+}
+
+void GraphParser::skip_line()
+// Skips past the end of the current line
+{
+	if (p < end && *p != '\n')
+		p = line_end();
+	if (p < end) {
+		p++;
+		line_num++;
+	}
+}
+
+string_view GraphParser::get_token()
+// Returns the next run of non-whitespace characters on the line
+{
+	skip_spaces();
+	const char *start = p;
+	while (p < end && !ends_token(*p))
+		p++;
+	return string_view(start, p - start);
+}
+
+string_view GraphParser::get_rest()
+// Returns the rest of the line, like 'get_string' in "Graph.cpp": the
+// leading and trailing whitespace is removed, and then a matching pair
+// of single or double quotes around what is left
+{
+	skip_spaces();
+	const char *start = p;
+	p = line_end();
+
+	const char *last = p;
+	while (last > start && is_space(last[-1]))
+		last--;
+	if (last - start >= 2 && (*start == '"' || *start == '\'')
+		&& last[-1] == *start) {
+		start++;
+		last--;
+	}
+	return string_view(start, last - start);
+}
+
+bool GraphParser::scan_int(int& value)
+// Converts the next token on the line to an integer.  Returns false if
+// it isn't one.  Node indices are most of what a graph file holds, so
+// the digits are converted here directly rather than by 'from_chars'.
+{
+	skip_spaces();
+	bool negative = false;
+	if (p < end && (*p == '+' || *p == '-'))
+		negative = (*p++ == '-');
+	const char *digits = p;
+	long long v = 0;
+	while (p < end && (unsigned)(*p - '0') < 10 && p - digits < 11)
+		v = 10*v + (*p++ - '0');
+	if (p == digits || v > 2147483647LL + negative
+		|| (p < end && !ends_token(*p)))
+		return false;
+	value = (int)(negative ? -v : v);
+	return true;
+}
+
+bool GraphParser::scan_double(double& value)
+// Converts the next token on the line to a floating-point value.
+// Returns false if it isn't one.
+{
+	skip_spaces();
+	if (p < end && *p == '+')
+		p++;
+	from_chars_result r = from_chars(p, end, value);
+	if (r.ec != errc() || (r.ptr < end && !ends_token(*r.ptr)))
+		return false;
+	p = r.ptr;
+	return true;
+}
+
+int GraphParser::get_int()
+// Converts the next token on the line to an integer, or exits
+{
+	int value = 0;
+	if (!scan_int(value))
+		error("expected an integer");
+	return value;
+}
+
+double GraphParser::get_double()
+// Converts the next token on the line to a floating-point value, or exits
+{
+	double value = 0;
+	if (!scan_double(value))
+		error("expected a number");
+	return value;
+}
+
+string_view GraphParser::get_key()
+// Returns the key at the start of the line.  Arc lines are nearly all
+// of a large file, so the arc keys are recognized by their first few
+// bytes, before the general scan for the end of the key.
+{
+	skip_spaces();
+	if (end - p > 13 && *p == 'w' && memcmp(p, "weighted_arc", 12) == 0
+		&& is_space(p[12])) {
+		p += 12;
+		return string_view(p - 12, 12);
+	}
+	if (end - p > 4 && *p == 'a' && memcmp(p, "arc", 3) == 0
+		&& is_space(p[3])) {
+		p += 3;
+		return string_view(p - 3, 3);
+	}
+	return get_token();
+}
+
+void GraphParser::read(Graph& g)
+// Reads the header, initializes 'g', and then reads the rest of the
+// lines into it
+{
+	graph = &g;
+	read_header();
+	graph->init(n_nodes);
+	graph->name_offsets.reserve(n_nodes + 2);
+	name_index.reserve(n_nodes + 1);
+	name_index[string_view()] = 0;
+
+	// (a guess at the number of arcs, from the length of a typical
+	// "weighted_arc" line, to save most of the copying as 'arcs' grows)
+	arcs.reserve((end - p) / 32);
+
+	while (read_line())
+		;
+
+	// Pack the arcs into the arc arrays
+	graph->build_arcs(arcs);
+	if (weighted_arcs)
+		graph->weighted = true;
+}
+
+void GraphParser::read(Graph& g, ThreadPool& pool)
+// Reads the header, initializes 'g', and then reads the rest of the
+// text in chunks on the threads of 'pool' (see "GraphParser.h")
+{
+	// Small files aren't worth splitting up, and the "Verbose" messages
+	// have to come in order
+	const size_t MinChunk = 1 << 20;
+	if (pool.size() == 1 || Verbose || (size_t)(end - p) < 2*MinChunk) {
+		read(g);
+		return;
+	}
+
+	graph = &g;
+	read_header();
+	graph->init(n_nodes);
+	graph->name_offsets.reserve(n_nodes + 2);
+	name_index.reserve(n_nodes + 1);
+	name_index[string_view()] = 0;
+
+	// cut the rest into a few chunks per thread, each ending at a newline
+	size_t chunk_size = (end - p) / (4*pool.size()) + 1;
+	if (chunk_size < MinChunk)
+		chunk_size = MinChunk;
+	vector<Chunk> chunks;
+	for (const char *first = p; first < end; ) {
+		Chunk chunk;
+		chunk.begin = first;
+		chunk.end = end;
+		if ((size_t)(end - first) > chunk_size) {
+			const char *newline = (const char *)memchr(first + chunk_size, '\n',
+				end - (first + chunk_size));
+			if (newline)
+				chunk.end = newline + 1;
+		}
+		chunks.push_back(chunk);
+		first = chunk.end;
+	}
+
+	atomic<int> next_chunk(0);
+	pool.run([&](int) {
+		for (int c = next_chunk++; c < (int)chunks.size(); c = next_chunk++) {
+			GraphParser chunk_parser(chunks[c].begin, chunks[c].end,
+				source_name);
+			chunk_parser.n_nodes = n_nodes;
+			chunk_parser.read_chunk(chunks[c]);
+		}
+	});
+
+	// Read the other lines in order, up to where the first chunk that
+	// stopped did.  A stop at a "q" ends the input there, and a stop at
+	// an arc line with an error reports it (after any error before it).
+	vector< vector<Graph::ArcRecord> > parts(chunks.size());
+	int first_line = line_num;
+	for (size_t c = 0; c < chunks.size(); c++) {
+		Chunk& chunk = chunks[c];
+		for (size_t d = 0; d < chunk.deferred.size(); d++) {
+			p = chunk.deferred[d].first;
+			line_num = first_line + chunk.deferred[d].second;
+			read_line();
+		}
+		parts[c].swap(chunk.arcs);
+		if (chunk.weighted)
+			weighted_arcs = true;
+		if (chunk.stop) {
+			p = chunk.stop;
+			line_num = first_line + chunk.stop_line;
+			read_line();
+			break;
+		}
+		first_line += chunk.lines;
+	}
+
+	// Merge the arc lists into the arc arrays
+	graph->build_arcs(parts, pool);
+	if (weighted_arcs)
+		graph->weighted = true;
+}
+
+void GraphParser::read_chunk(Chunk& chunk)
+// Reads the arc lines of 'chunk' into 'chunk.arcs' and notes where the
+// other lines are.  This stops at a "q" line or an arc line with an
+// error, without reporting anything.
+{
+	chunk.arcs.reserve((end - p) / 32);
+
+	line_num = 0;
+	for (;;) {
+		skip_spaces();
+		if (p == end)
+			break;
+		const char *line = p;
+		string_view key = get_key();
+		if (key.empty() || key[0] == '#') {
+			// a blank line or a comment
+		}
+		else if (key == "weighted_arc" || key == "arc") {
+			Graph::ArcRecord arc;
+			if (!scan_arc(key.size() > 3, arc)) {
+				chunk.stop = line;
+				chunk.stop_line = line_num;
+				break;
+			}
+			chunk.arcs.push_back(arc);
+			if (key.size() > 3)
+				chunk.weighted = true;
+		}
+		else if (key == "q") {
+			chunk.stop = line;
+			chunk.stop_line = line_num;
+			break;
+		}
+		else
+			chunk.deferred.push_back(make_pair(line, line_num));
+		skip_line();
+	}
+	chunk.lines = line_num;
+}
+
+void GraphParser::read_header()
+// Reads the "magic number" and the number of nodes, which (as with the
+// '>>' in 'Graph::read') may be separated by any whitespace
+{
+	for (;;) {
+		skip_spaces();
+		if (p == end || *p != '\n')
+			break;
+		p++;
+		line_num++;
+	}
+	if (get_token() != "Graph") {
+		cerr << "input source '" << source_name
+			<< "' is not in Graph format\n";
+		exit(1);
+	}
+
+	for (;;) {
+		skip_spaces();
+		if (p == end || *p != '\n')
+			break;
+		p++;
+		line_num++;
+	}
+	n_nodes = get_int();
+	if (n_nodes < 0)
+		error("the number of nodes can't be negative");
+	skip_line();
+}
+
+bool GraphParser::read_line()
+// Reads one line.  Returns false when there are no more to read.
+{
+	skip_spaces();
+	if (p == end)
+		return false;
+
+	string_view key = get_key();
+	if (key.empty()) {
+		// a blank line
+	}
+	else if (key == "weighted_arc")
+		read_arc(true);
+	else if (key == "arc")
+		read_arc(false);
+	else if (key[0] == '#') {
+		// a comment
+	}
+	else if (key == "node")
+		read_node();
+	else if (key == "node_value")
+		read_node_value();
+#ifdef GRAPHICAL
+	else if (key == "node_pos")
+		read_node_pos();
+	else if (key == "arc_point")
+		read_arc_point();
+	else if (key == "scale")
+		read_scale();
+#endif
+	else if (key == "q")
+		return false;
+	else
+		cerr << source_name << ":" << line_num
+			<< " unknown object key '" << key << "'\n";
+
+	skip_line();
+	return true;
+}
+
+void GraphParser::read_node()
+//   node <name>
+{
+	if (node_count >= n_nodes)
+		error("too many nodes!");
+
+	string_view name = get_rest();
+	unordered_map<string_view, int>::iterator named = name_index.find(name);
+	if (named == name_index.end()) {
+		named = name_index.insert(make_pair(name,
+			graph->add_name(name))).first;
+	}
+	graph->node_names[node_count] = named->second;
+	node_count++;
+	if (Verbose)
+		cout << "read node '" << name << "'\n";
+}
+
+bool GraphParser::scan_arc(bool with_weight, Graph::ArcRecord& arc)
+// Scans the values of an arc line into 'arc'.  Returns false, without
+// reporting anything, if they are malformed or out of range.
+{
+	int start_i, end_i;
+	double weight = 1;
+	if (!scan_int(start_i) || !scan_int(end_i)
+		|| (with_weight && !scan_double(weight)))
+		return false;
+	if ((unsigned)(start_i - 1) >= (unsigned)n_nodes
+		|| (unsigned)(end_i - 1) >= (unsigned)n_nodes || !(weight > 0))
+		return false;
+
+	arc.start = start_i - 1;
+	arc.end = end_i - 1;
+	arc.weight = weight;
+	return true;
+}
+
+void GraphParser::read_arc(bool with_weight)
+//   arc <start-index> <end-index>
+//   weighted_arc <start-index> <end-index> <weight>
+{
+	const char *values = p;
+	Graph::ArcRecord arc;
+	if (!scan_arc(with_weight, arc)) {
+		// go over the values again to report what is wrong
+		p = values;
+		int start_i = get_int();
+		int end_i = get_int();
+		if (with_weight)
+			get_double();
+		if (!check_arc_indices(start_i, end_i, n_nodes, source_name, line_num))
+			exit(1);
+		error("arc weight must be positive");
+	}
+	arcs.push_back(arc);
+	if (with_weight)
+		weighted_arcs = true;
+
+	if (Verbose) {
+		if (with_weight)
+			cout << "read weighted arc from " << arc.start + 1 << " to "
+			<< arc.end + 1 << " with weight " << arc.weight << endl;
+		else
+			cout << "read arc from " << arc.start + 1 << " to "
+			<< arc.end + 1 << endl;
+	}
+}
+
+void GraphParser::read_node_value()
+//   node_value <node-index> <value>
+{
+	int index = get_int();
+	double value = get_double();
+	if (!check_node_index(index, n_nodes, source_name, line_num))
+		exit(1);
+	graph->node_values[index - 1] = value;
+	if (Verbose)
+		cout << "read node value " << index << " valued at " << value << endl;
+}
+
+#ifdef GRAPHICAL
+
+void GraphParser::read_node_pos()
+//   node_pos <node-index> <x> <y>
+{
+	int index = get_int();
+	double x = get_double();
+	double y = get_double();
+	if (!check_node_index(index, n_nodes, source_name, line_num))
+		exit(1);
+	graph->node_pos[index - 1] = PDFPoint(x, y);
+	graph->astar_ratio = -1;
+	if (Verbose)
+		cout << "read node position " << index
+		<< ", ( " << x << ", " << y << ")" << endl;
+}
+
+void GraphParser::read_arc_point()
+//   arc_point <start> <end> <x> <y>
+{
+	int start = get_int();
+	int end = get_int();
+	double x = get_double();
+	double y = get_double();
+	if (!check_arc_indices(start, end, n_nodes, source_name, line_num))
+		exit(1);
+	graph->set_arc_point(start - 1, end - 1, PDFPoint(x, y));
+	if (Verbose)
+		cout << "read arc point " << start << ", " << end
+		<< ", ( " << x << ", " << y << ")" << endl;
+}
+
+void GraphParser::read_scale()
+//   scale <scale-value>
+{
+	double s = get_double();
+	if (s <= 0)
+		error("scale must be positive");
+	graph->scale = s;
+	if (Verbose)
+		cout << "read scale " << s << endl;
+}
+
+#endif
@@ -0,0 +1,240 @@
+/*
+ * File:   GraphParser.h
+ * Author: bret and daniel
+ *
+ * A fast reader for the Graph text format (described in 'Graph::read')
+ * that works on the whole file in memory instead of token by token from
+ * an 'istream'.  The file is mapped into memory where the system allows
+ * it ('MappedFile'), and read into one buffer otherwise.  The parser
+ * then walks the bytes a line at a time, converting the numbers in place
+ * with 'from_chars', so the only allocations are for the arc list and
+ * the node names.  The 'Graph(filename)' constructor uses it; reading
+ * from an 'istream' still goes through 'Graph::read', which can stop at
+ * a "q" line before the end of the input.
+ *
+ * Large files can be read on several threads: the text is cut into
+ * chunks at line boundaries, the threads parse the arc lines of the
+ * chunks into separate lists, and the calling thread then reads the
+ * few other lines in order (so the nodes are numbered as they appear)
+ * and merges the lists into the arc arrays.  Errors are reported as
+ * the serial reader would report them, the first one in the file.
+ *
+ * The grammar is the same, but the parser works by lines: the values
+ * of a key have to be on its line, anything after them is ignored, and
+ * a malformed number is reported (with its line number) as an error.
+ *
+ * The parser also imports a few common formats for large graphs (the
+ * importers are in "GraphImport.cpp"):
+ *
+ *   EdgeList      SNAP-style edge lists: "<start> <end> [<weight>]" lines
+ *                 and '#' comments.  The ids count from 0, so id 'k' is
+ *                 node index k + 1, unless most ids up to the largest
+ *                 are unused: then the nodes are the ids that appear,
+ *                 in order, named by their ids.  (The ids are read in
+ *                 a pass of their own first, to number the nodes.)  A
+ *                 "# Undirected" comment before the first edge makes
+ *                 each edge an arc both ways.
+ *   Dimacs        DIMACS shortest path files (".gr"): a "p sp <n> <m>"
+ *                 line, then "a <start> <end> <weight>" lines.
+ *   Metis         METIS graph files (".graph"): a "<n> <m> [<fmt>]" line,
+ *                 then one line per node listing its neighbors (and edge
+ *                 weights, if 'fmt' says so).  The first node weight, if
+ *                 there is one, becomes the node value.
+ *   MatrixMarket  Matrix Market coordinate files (".mtx"): entry (i, j)
+ *                 is the arc i->j, weighted by its value; a symmetric
+ *                 matrix gives the arcs both ways.
+ *
+ * 'detect_format' picks the format from the first bytes of the file, and
+ * from its extension where those don't tell.  Each importer reads the
+ * text twice: once to check it and count the arcs of each node, and
+ * again to store the arcs straight into arrays of the counted size.
+ * Imported nodes are unnamed (but for the sparse edge list ids).
+ */
+
+#ifndef __GRAPHPARSER_H
+#define __GRAPHPARSER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+
+#include "Graph.h"
+
+using namespace std;
+
+class ThreadPool;
+
+/****************************************************************************
+ *
+ * CLASS:  MappedFile
+ *
+ ****************************************************************************/
+
+// The contents of a file: an 'mmap' of it on POSIX systems, or a copy
+// read into memory on others (or if the mapping fails)
+
+class MappedFile {
+ public:
+
+  // How the contents will be used
+  enum Access {
+    Sequential,   // read once, front to back
+    CopyOnWrite   // read in any order, and changed in memory (a mapped
+                  // page is copied when it is first written, so the file
+                  // itself never changes)
+  };
+
+  MappedFile( const string& filename, Access access = Sequential );
+  ~MappedFile();
+
+  bool is_open() const { return ok; }   // false if the file can't be read
+  const char *begin() const { return data; }
+  const char *end() const { return data + length; }
+  size_t size() const { return length; }
+
+  // The contents, for changing in place (with 'CopyOnWrite' only)
+  char *writable_begin() { return (access == CopyOnWrite ? data : NULL); }
+
+ private:
+  bool ok;
+  bool mapped;        // true if 'data' is mapped, false if it is allocated
+  Access access;
+  char *data;
+  size_t length;
+
+  // (not copyable)
+  MappedFile( const MappedFile& );
+  MappedFile& operator=( const MappedFile& );
+};
+
+/****************************************************************************
+ *
+ * CLASS:  GraphParser
+ *
+ ****************************************************************************/
+
+class GraphParser {
+ public:
+
+  // The formats the parser reads
+  enum Format {
+    GraphText,      // the Graph format itself
+    EdgeList,
+    Dimacs,
+    Metis,
+    MatrixMarket
+  };
+
+  // Returns the format of the text from 'begin' to 'end' (the contents of
+  // 'filename'); anything unrecognized is taken to be 'GraphText'
+  static Format detect_format( const string& filename,
+                               const char *begin, const char *end );
+
+  /* Constructor: parses the text from 'begin' up to 'end'; errors are
+   * reported with 'source_name' and the line number, and the program
+   * exits, as with 'Graph::read' */
+  GraphParser( const char *begin, const char *end, const string& source_name );
+
+  // Reads the whole text (the header and the rest) into 'graph', which
+  // is initialized for the number of nodes the header gives
+  void read( Graph& graph );
+
+  // The same, parsing the arc lines on the threads of 'pool'
+  void read( Graph& graph, ThreadPool& pool );
+
+  // Reads the whole text, in 'format' (other than 'GraphText'), into
+  // 'graph'
+  void import( Graph& graph, Format format );
+
+ private:
+  const char *p;      // the next character to parse
+  const char *end;
+  string source_name;
+  int line_num;
+
+  Graph *graph;
+  int n_nodes;
+  int node_count;     // number of "node" lines so far
+  vector<Graph::ArcRecord> arcs;
+  bool weighted_arcs; // true once a "weighted_arc" line is read
+
+  // The index in the graph's name pool of each distinct node name (the keys
+  // point into the text, which outlives the parse)
+  unordered_map<string_view, int> name_index;
+
+  void read_header();
+  bool read_line();   // false after a "q" line or at the end of the text
+
+  // The line scanning primitives
+  void skip_spaces();
+  const char *line_end() const;
+  void skip_line();
+  string_view get_token();
+  string_view get_rest();
+  bool scan_int( int& value );
+  bool scan_double( double& value );
+  int get_int();
+  double get_double();
+  string_view get_key();
+  [[noreturn]] void error( const string& message ) const;
+
+  // The keys
+  void read_node();
+  bool scan_arc( bool with_weight, Graph::ArcRecord& arc );
+  void read_arc( bool with_weight );
+  void read_node_value();
+#ifdef GRAPHICAL
+  void read_node_pos();
+  void read_arc_point();
+  void read_scale();
+#endif
+
+  // The importers.  Each 'scan_' function reads the whole text once,
+  // passing the arcs to 'add_edge', which counts them in the first pass
+  // and stores them in the second.
+  bool filling;           // false in the first pass, true in the second
+  bool mirror_edges;      // true if each edge is also stored reversed
+  bool undirected;        // true if the format says the graph is
+  long long arc_total;    // number of arcs counted in the first pass
+  vector<int> row_counts; // arcs of each node in the first pass; where
+                          // the next arc of each node goes in the second
+  void scan_edges( Format format );
+  void scan_edge_list();
+  void scan_dimacs();
+  void scan_metis();
+  void scan_matrix_market();
+  void add_edge( int start, int end, double weight );
+  void sort_rows();
+
+  // The edge list ids: a bit for each id used, and the largest, in the
+  // first pass, and then the distinct ids in order, if they are too
+  // sparse to be node indices
+  vector<uint64_t> id_bits;
+  int max_id;
+  vector<int> sparse_ids;
+  void scan_edge_lines( bool ids_only );
+  void mark_id( int id );
+  void number_edge_ids();
+  int node_of_id( int id ) const;
+
+  // A piece of the text, read by one thread in 'read(graph, pool)'.
+  // Its arc lines go into 'arcs'; its other lines are left for the
+  // calling thread to read afterwards, in order.
+  struct Chunk {
+    const char *begin, *end;
+    vector<Graph::ArcRecord> arcs;
+    vector< pair<const char *, int> > deferred; // lines, and line numbers
+                                                // from the chunk start
+    const char *stop;   // a "q" line or an arc line with an error, or NULL
+    int stop_line;
+    int lines;          // number of lines in the chunk (if not stopped)
+    bool weighted;      // true if it has a "weighted_arc" line
+
+    Chunk() : begin(NULL), end(NULL), stop(NULL), stop_line(0), lines(0),
+      weighted(false) {}
+  };
+  void read_chunk( Chunk& chunk );
+};
+
+#endif
@@ -0,0 +1,382 @@
+/*
+ * File:   GraphTraversal.h
+ * Author: bret and daniel
+ *
+ * The templated graph traversals.  Each one is parameterized by a
+ * visitor (see "GraphVisitor.h") so the caller decides what happens at
+ * each step: drawing, counting, stopping early, or nothing at all.
+ *
+ * This file is included at the end of "Graph.h"; don't include it
+ * directly.
+ */
+
+#ifndef __GRAPHTRAVERSAL_H
+#define __GRAPHTRAVERSAL_H
+
+#include <stdint.h>
+
+#include "IndexedHeap.h"
+
+bool check_index(int i, int n, const char *msg);
+
+//-----------------------------------------------------------------------------
+//	Function: void breadth_first( int start_i, Visitor& visitor,
+//                                vector<int>& parent )
+//  
+//	Title:	Graph
+//
+//	Description:
+//				a breadth-first traversal of the nodes reachable from
+//     'start_i', reporting each step to 'visitor'
+//
+//  Returns: N/A ('parent' holds the breadth-first spanning tree)
+//
+//  Parameters: int representing the node from which to start traversing,
+//     the visitor, and the parent array to fill in
+//
+//-----------------------------------------------------------------------------
+template <class Visitor>
+void Graph::breadth_first(int start_i, Visitor& visitor, vector<int>& parent)
+{
+	parent.assign(n, -1);
+	if (!check_index(start_i, n, "breadth_first()"))
+		return;
+	set_all_node_states(0);
+
+	vector<int> queue;
+	queue.reserve(n);
+	visitor.discover_node(start_i);
+	node_states[start_i] = Visited;
+	queue.push_back(start_i);
+	for (size_t front = 0; front < queue.size(); front++)
+	{
+		int root = queue[front];
+		for (int a = first_arc(root); a < last_arc(root); a++)
+		{
+			int k = arc_target(a);
+			visitor.examine_arc(root, k, arc_weight(a));
+			if (!(node_states[k] == Visited))
+			{
+				node_states[k] = Visited;
+				queue.push_back(k);
+				parent[k] = root;
+				visitor.tree_arc(root, k);
+				visitor.discover_node(k);
+				if (visitor.done())
+					return;
+			}
+		}
+		visitor.finish_node(root);
+		if (visitor.done())
+			return;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+//	Function: void direction_optimizing_bfs( int start_i, Visitor& visitor,
+//                                           vector<int>& parent,
+//                                           vector<int> *level )
+//  
+//	Title:	Graph
+//
+//	Description:
+//				a breadth-first traversal that processes one level at a
+//     time, choosing the cheaper direction for each level (Beamer et al.):
+//
+//       top-down:   each frontier node examines its outgoing arcs, looking
+//                   for unvisited nodes (as in 'breadth_first')
+//       bottom-up:  each unvisited node examines its incoming arcs, looking
+//                   for a frontier node, and stops at the first one found
+//
+//     On low-diameter graphs the middle levels have huge frontiers whose
+//     arcs mostly lead to visited nodes; bottom-up steps skip most of
+//     that work.  The traversal switches to bottom-up when the frontier's
+//     outgoing arcs outnumber those of the unvisited nodes by 'Alpha', and
+//     back when the frontier shrinks below n / 'Beta' nodes.
+//
+//     The levels are the same as for 'breadth_first'.  The parents are a
+//     valid breadth-first tree, but in bottom-up levels a node's parent
+//     is its smallest-index frontier neighbor rather than the first one
+//     dequeued, so the tree itself may differ.
+//
+//  Returns: N/A ('parent' holds the breadth-first spanning tree)
+//
+//  Parameters: int representing the node from which to start traversing,
+//     the visitor, the parent array to fill in, and optionally an array
+//     for the level (hop distance) of each node (-1 if unreached)
+//
+//-----------------------------------------------------------------------------
+template <class Visitor>
+void Graph::direction_optimizing_bfs(int start_i, Visitor& visitor,
+	vector<int>& parent, vector<int> *level)
+{
+	const int Alpha = 14;
+	const int Beta = 24;
+
+	parent.assign(n, -1);
+	set_all_node_states(0);
+	if (level)
+		level->assign(n, -1);
+	if (!check_index(start_i, n, "direction_optimizing_bfs()"))
+		return;
+	update_incoming();
+
+	// the frontier, as a list and as a bitmap for the bottom-up steps
+	vector<int> frontier, next;
+	vector<uint64_t> in_frontier((n + 63)/64, 0);
+
+	frontier.push_back(start_i);
+	node_states[start_i] = Visited;
+	if (level)
+		(*level)[start_i] = 0;
+	visitor.discover_node(start_i);
+	if (visitor.done())
+		return;
+
+	long unexplored_arcs = m - out_degree(start_i);
+	bool bottom_up = false;
+	for (int depth = 1; !frontier.empty(); depth++)
+	{
+		long frontier_arcs = 0;
+		for (size_t f = 0; f < frontier.size(); f++)
+			frontier_arcs += out_degree(frontier[f]);
+
+		// pick the direction for this level
+		if (!bottom_up && frontier_arcs > unexplored_arcs/Alpha)
+			bottom_up = true;
+		else if (bottom_up && (long)frontier.size() < n/Beta)
+			bottom_up = false;
+
+		next.clear();
+		if (bottom_up)
+		{
+			for (size_t f = 0; f < frontier.size(); f++)
+				in_frontier[frontier[f] >> 6] |= (uint64_t)1 << (frontier[f] & 63);
+
+			for (int v = 0; v < n; v++)
+			{
+				if (node_states[v] == Visited)
+					continue;
+				for (int k = first_in_arc(v); k < last_in_arc(v); k++)
+				{
+					int u = in_arc_source(k);
+					visitor.examine_arc(u, v, in_arc_weight(k));
+					if (in_frontier[u >> 6] & ((uint64_t)1 << (u & 63)))
+					{
+						node_states[v] = Visited;
+						next.push_back(v);
+						parent[v] = u;
+						visitor.tree_arc(u, v);
+						visitor.discover_node(v);
+						if (visitor.done())
+							return;
+						break;
+					}
+				}
+			}
+
+			for (size_t f = 0; f < frontier.size(); f++)
+				in_frontier[frontier[f] >> 6] = 0;
+		}
+		else
+		{
+			for (size_t f = 0; f < frontier.size(); f++)
+			{
+				int u = frontier[f];
+				for (int a = first_arc(u); a < last_arc(u); a++)
+				{
+					int v = arc_target(a);
+					visitor.examine_arc(u, v, arc_weight(a));
+					if (!(node_states[v] == Visited))
+					{
+						node_states[v] = Visited;
+						next.push_back(v);
+						parent[v] = u;
+						visitor.tree_arc(u, v);
+						visitor.discover_node(v);
+						if (visitor.done())
+							return;
+					}
+				}
+			}
+		}
+
+		// the old frontier is finished
+		for (size_t f = 0; f < frontier.size(); f++)
+			visitor.finish_node(frontier[f]);
+		if (visitor.done())
+			return;
+
+		for (size_t f = 0; f < next.size(); f++)
+		{
+			unexplored_arcs -= out_degree(next[f]);
+			if (level)
+				(*level)[next[f]] = depth;
+		}
+		frontier.swap(next);
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+//	Function: void depth_first( int start_i, Visitor& visitor,
+//                              vector<int>& parent, vector<int> *discover_time,
+//                              vector<int> *finish_time )
+//  
+//	Title:	Graph
+//
+//	Description:
+//				a depth-first traversal of the nodes reachable from
+//     'start_i', reporting each step to 'visitor'.  This does not recurse:
+//     the path from 'start_i' is kept on an explicit stack along with the
+//     next arc to try from each node, so each row is scanned only once and
+//     arbitrarily deep graphs are fine.  A node is 'Active' while it is on
+//     the stack and 'Finished' once all its arcs have been examined.
+//
+//  Returns: N/A ('parent' holds the depth-first spanning tree)
+//
+//  Parameters: int representing the node from which to start traversing,
+//     the visitor, the parent array to fill in, and optionally arrays for
+//     the discovery and finish time of each node (the times count up from
+//     1 across both kinds of event; -1 means never reached)
+//
+//-----------------------------------------------------------------------------
+template <class Visitor>
+void Graph::depth_first(int start_i, Visitor& visitor, vector<int>& parent,
+	vector<int> *discover_time, vector<int> *finish_time)
+{
+	parent.assign(n, -1);
+	set_all_node_states(NoState);
+	if (discover_time)
+		discover_time->assign(n, -1);
+	if (finish_time)
+		finish_time->assign(n, -1);
+	if (!check_index(start_i, n, "depth_first()"))
+		return;
+
+	// each stack entry is a node and the next of its arcs to examine
+	struct Frame {
+		int node;
+		int arc;
+	};
+	vector<Frame> stack;
+	int clock = 0;
+
+	Frame start = { start_i, first_arc(start_i) };
+	stack.push_back(start);
+	node_states[start_i] = Active;
+	if (discover_time)
+		(*discover_time)[start_i] = ++clock;
+	visitor.discover_node(start_i);
+	if (visitor.done())
+		return;
+
+	while (!stack.empty())
+	{
+		Frame& top = stack.back();
+		int i = top.node;
+		if (top.arc < last_arc(i))
+		{
+			int a = top.arc++;
+			int l = arc_target(a);
+			visitor.examine_arc(i, l, arc_weight(a));
+			if (node_states[l] == NoState)
+			{
+				parent[l] = i;
+				visitor.tree_arc(i, l);
+
+				// descend into 'l' ('top' is invalid after the push)
+				Frame next = { l, first_arc(l) };
+				stack.push_back(next);
+				node_states[l] = Active;
+				if (discover_time)
+					(*discover_time)[l] = ++clock;
+				visitor.discover_node(l);
+				if (visitor.done())
+					return;
+			}
+		}
+		else
+		{
+			// every arc has been examined, so 'i' is finished
+			stack.pop_back();
+			node_states[i] = Finished;
+			if (finish_time)
+				(*finish_time)[i] = ++clock;
+			visitor.finish_node(i);
+			if (visitor.done())
+				return;
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+//	Function: void shortest_paths( int source_i, Visitor& visitor,
+//                                 vector<double>& dist, vector<int>& parent,
+//                                 int strategy )
+//  
+//	Title:	Graph
+//
+//	Description:
+//				Dijkstra's algorithm from 'source_i', reporting each step
+//     to 'visitor'.  A node is "discovered" when it is first reached and
+//     "finished" when it is settled (its distance is final).
+//
+//  Returns: N/A ('dist' holds the distances, and 'parent' the shortest
+//     path tree)
+//
+//  Parameters: int representing the source node, the visitor, the arrays
+//     to fill in, and the strategy for finding the next node
+//     ('HeapDijkstra' or 'ScanDijkstra')
+//
+//-----------------------------------------------------------------------------
+template <class Visitor>
+void Graph::shortest_paths(int source_i, Visitor& visitor,
+	vector<double>& dist, vector<int>& parent, int strategy)
+{
+	// Initialize all distances as INFINITE and all nodes as unsettled
+	dist.assign(n, InfiniteDistance);
+	parent.assign(n, -1);
+	set_all_node_states(0);
+	if (!check_index(source_i, n, "shortest_paths()"))
+		return;
+
+	IndexedHeap queue(strategy == ScanDijkstra ? 0 : n);
+	IndexedHeap *heap = (strategy == ScanDijkstra ? NULL : &queue);
+
+	// Distance of source vertex from itself is always 0
+	dist[source_i] = 0;
+	if (heap)
+		heap->push(source_i, 0);
+	visitor.discover_node(source_i);
+
+	int u;
+	while ((u = settle_next(dist, heap)) != -1)
+	{
+		visitor.finish_node(u);
+		if (visitor.done())
+			return;
+
+		// relax each arc leaving 'u'
+		for (int a = first_arc(u); a < last_arc(u); a++)
+		{
+			int v = arc_target(a);
+			double d = dist[u] + arc_weight(a);
+			visitor.examine_arc(u, v, arc_weight(a));
+			if (!(node_states[v] == Visited) && d < dist[v])
+			{
+				if (dist[v] == InfiniteDistance)
+					visitor.discover_node(v);
+				dist[v] = d;
+				parent[v] = u;
+				if (heap)
+					heap->push_or_decrease(v, d);
+				visitor.tree_arc(u, v);
+			}
+		}
+	}
+}
+
+#endif
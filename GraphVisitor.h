@@ -0,0 +1,158 @@
+/*
+ * File:   GraphVisitor.h
+ * Author: bret and daniel
+ *
+ * Visitors for the templated graph traversals (see "GraphTraversal.h").
+ * A traversal calls its visitor on each of these events:
+ *
+ *   discover_node(v)         node 'v' is reached for the first time
+ *   examine_arc(u, v, w)     the arc u->v (of weight 'w') is looked at
+ *   tree_arc(u, v)           'u' becomes the parent of 'v' in the tree
+ *   finish_node(v)           every arc leaving 'v' has been examined
+ *                            (in Dijkstra's algorithm: 'v' is settled)
+ *
+ * and stops early as soon as 'done()' returns true.  Any class with
+ * these members can be a visitor; no base class or virtual functions
+ * are involved, so calls to empty members compile away entirely.
+ */
+
+#ifndef __GRAPHVISITOR_H
+#define __GRAPHVISITOR_H
+
+#include <string>
+
+#include "Graph.h"
+#include "Subgraph.h"
+
+using namespace std;
+
+/****************************************************************************
+ *
+ * STRUCT:  NullVisitor
+ *
+ ****************************************************************************/
+
+// A visitor that does nothing (the traversal runs at full speed)
+
+struct NullVisitor {
+  void discover_node( int ) {}
+  void examine_arc( int, int, double ) {}
+  void tree_arc( int, int ) {}
+  void finish_node( int ) {}
+  bool done() const { return false; }
+};
+
+
+/****************************************************************************
+ *
+ * STRUCT:  CountingVisitor
+ *
+ ****************************************************************************/
+
+// A visitor that just counts the events
+
+struct CountingVisitor : public NullVisitor {
+  long discovered;
+  long examined;
+  long finished;
+
+  CountingVisitor() : discovered(0), examined(0), finished(0) {}
+  void discover_node( int ) { discovered++; }
+  void examine_arc( int, int, double ) { examined++; }
+  void finish_node( int ) { finished++; }
+};
+
+
+/****************************************************************************
+ *
+ * STRUCT:  TargetVisitor
+ *
+ ****************************************************************************/
+
+// A visitor that stops the traversal once 'target' is discovered
+// (or, with 'on_finish', once it is finished), counting the nodes
+// finished along the way
+
+struct TargetVisitor : public NullVisitor {
+  int target;
+  bool on_finish;
+  bool found;
+  long finished;
+
+  TargetVisitor( int target_i, bool finish = false )
+    : target(target_i), on_finish(finish), found(false), finished(0) {}
+  void discover_node( int v ) { if (!on_finish && v == target) found = true; }
+  void finish_node( int v ) {
+    finished++;
+    if (on_finish && v == target)
+      found = true;
+  }
+  bool done() const { return found; }
+};
+
+
+/****************************************************************************
+ *
+ * STRUCT:  OrderVisitor
+ *
+ ****************************************************************************/
+
+// A visitor that lists the nodes in the order they are discovered (or,
+// with 'on_finish', the order they are finished)
+
+struct OrderVisitor : public NullVisitor {
+  vector<int>& order;
+  bool on_finish;
+
+  OrderVisitor( vector<int>& node_order, bool finish = false )
+    : order(node_order), on_finish(finish) {}
+  void discover_node( int v ) { if (!on_finish) order.push_back(v); }
+  void finish_node( int v ) { if (on_finish) order.push_back(v); }
+};
+
+
+/****************************************************************************
+ *
+ * CLASS:  PDFVisitor
+ *
+ ****************************************************************************/
+
+// The traversal animation: each visit draws 'graph' on a new PDF page
+// over the spanning tree built so far.  The visits are drawn as the
+// nodes are discovered or, with 'on_finish', as they are finished (and
+// listed in that order, as by 'OrderVisitor').  The tree is read from
+// 'parent', the array the traversal is filling in, and made into a view
+// of the nodes of 'graph' only when it is drawn.
+
+class PDFVisitor : public OrderVisitor {
+ public:
+  PDFVisitor( Graph *g, const vector<int>& tree_parent, vector<int>& order,
+	      const string& annotation, bool finish = false )
+    : OrderVisitor(order, finish), graph(g), parent(tree_parent), tree(*g),
+      annot(annotation) {}
+
+  void discover_node( int v ) {
+    OrderVisitor::discover_node(v);
+    if (!on_finish)
+      visit(v);
+  }
+  void finish_node( int v ) {
+    OrderVisitor::finish_node(v);
+    if (on_finish)
+      visit(v);
+  }
+
+ private:
+  Graph *graph;
+  const vector<int>& parent;
+  Subgraph tree;
+  string annot;
+
+  void visit( int v ) {
+    // the tree arcs point from each node to its parent
+    tree.set_tree_arcs(parent);
+    graph->visit_node(v, annot, tree);
+  }
+};
+
+#endif
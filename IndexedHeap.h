@@ -0,0 +1,124 @@
+/*
+ * File:   IndexedHeap.h
+ * Author: bret and daniel
+ *
+ * An addressable 4-ary min-heap of the integers 0..n-1 keyed by 'double'
+ * values, for priority-queue graph algorithms such as Dijkstra's.
+ * Because the heap knows where each item is, the key of an item already
+ * in the heap can be lowered in O(log n) time ("decrease-key").
+ */
+
+#ifndef __INDEXEDHEAP_H
+#define __INDEXEDHEAP_H
+
+#include <vector>
+
+using namespace std;
+
+class IndexedHeap {
+ public:
+
+  /* Constructor: an empty heap that can hold the items 0..n_items-1 */
+  IndexedHeap( int n_items ) : pos(n_items, -1), keys(n_items, 0) {}
+
+  bool empty() const { return heap.empty(); }
+  int size() const { return (int)heap.size(); }
+  bool contains( int item ) const { return pos[item] >= 0; }
+  int top() const { return heap[0]; }             // item with smallest key
+  double top_key() const { return keys[heap[0]]; }
+  double key( int item ) const { return keys[item]; }
+
+  void push( int item, double key ) {
+    // PRE: 'item' is not in the heap
+    keys[item] = key;
+    pos[item] = (int)heap.size();
+    heap.push_back(item);
+    sift_up(pos[item]);
+  }
+
+  void decrease_key( int item, double key ) {
+    // PRE: 'item' is in the heap and 'key' is no larger than its key
+    keys[item] = key;
+    sift_up(pos[item]);
+  }
+
+  bool push_or_decrease( int item, double key ) {
+    // Adds 'item' with 'key', or lowers its key if 'key' is smaller.
+    // Returns true if the heap changed.
+    if (pos[item] < 0)
+      push(item, key);
+    else if (key < keys[item])
+      decrease_key(item, key);
+    else
+      return false;
+    return true;
+  }
+
+  int pop() {
+    // Removes and returns the item with the smallest key
+    int item = heap[0];
+    int last = heap.back();
+    heap.pop_back();
+    pos[item] = -1;
+    if (!heap.empty()) {
+      heap[0] = last;
+      pos[last] = 0;
+      sift_down(0);
+    }
+    return item;
+  }
+
+  void clear() {
+    for (size_t k = 0; k < heap.size(); k++)
+      pos[heap[k]] = -1;
+    heap.clear();
+  }
+
+ private:
+
+  static const int Arity = 4;
+
+  vector<int> heap;    // the items, in heap order
+  vector<int> pos;     // 'pos[item]' is its index in 'heap', or -1
+  vector<double> keys; // 'keys[item]' is the key of 'item'
+
+  void sift_up( int k ) {
+    int item = heap[k];
+    double key = keys[item];
+    while (k > 0) {
+      int parent = (k - 1)/Arity;
+      if (keys[heap[parent]] <= key)
+        break;
+      heap[k] = heap[parent];
+      pos[heap[k]] = k;
+      k = parent;
+    }
+    heap[k] = item;
+    pos[item] = k;
+  }
+
+  void sift_down( int k ) {
+    int item = heap[k];
+    double key = keys[item];
+    int size = (int)heap.size();
+    for (;;) {
+      int first = Arity*k + 1;
+      if (first >= size)
+        break;
+      int last = (first + Arity < size ? first + Arity : size);
+      int best = first;
+      for (int c = first + 1; c < last; c++)
+        if (keys[heap[c]] < keys[heap[best]])
+          best = c;
+      if (key <= keys[heap[best]])
+        break;
+      heap[k] = heap[best];
+      pos[heap[k]] = k;
+      k = best;
+    }
+    heap[k] = item;
+    pos[item] = k;
+  }
+};
+
+#endif
@@ -0,0 +1,301 @@
+/*
+ * File:   Landmarks.cpp
+ * Author: bret and daniel
+ */
+
+#include <fstream>
+#include <atomic>
+#include <algorithm>
+
+#include "Landmarks.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+bool check_index(int i, int n, const char *msg);
+bool check_node_index(int index, int n_nodes,
+	const string& source_name, int line_num);
+
+/*****************/
+/* Preprocessing */
+/*****************/
+
+static void reverse_dijkstra(const Graph& graph, int dest_i,
+	vector<double>& dist, IndexedHeap& heap)
+// Sets 'dist[v]' to the distance from each node 'v' to 'dest_i', by
+// Dijkstra's algorithm over the incoming arcs (which must be up to date)
+{
+	dist.assign(graph.node_count(), InfiniteDistance);
+	dist[dest_i] = 0;
+	heap.push(dest_i, 0);
+	while (!heap.empty()) {
+		int u = heap.pop();
+		for (int k = graph.first_in_arc(u); k < graph.last_in_arc(u); k++) {
+			int v = graph.in_arc_source(k);
+			double d = dist[u] + graph.in_arc_weight(k);
+			if (d < dist[v]) {
+				dist[v] = d;
+				heap.push_or_decrease(v, d);
+			}
+		}
+	}
+}
+
+static int farthest(const vector<double>& dist)
+// Returns the node with the largest 'dist' (unreachable nodes first)
+{
+	int far = 0;
+	for (int v = 1; v < (int)dist.size(); v++)
+		if (dist[v] > dist[far])
+			far = v;
+	return far;
+}
+
+Landmarks::Landmarks(Graph& graph, int n_landmarks, ThreadPool& pool)
+	: graph(graph), n(graph.node_count()), k(n_landmarks)
+// Chooses 'n_landmarks' landmarks of 'graph' and computes their tables
+{
+	if (k > n)
+		k = n;
+	if (k < 0)
+		k = 0;
+	select(pool);
+	init_queries();
+}
+
+void Landmarks::select(ThreadPool& pool)
+// Chooses the landmarks by "farthest point" selection: the first is the
+// node farthest from node 0, and each one after that is the node
+// farthest from all those chosen so far, which spreads them around the
+// edges of the graph where the bounds are best.  Each choice depends on
+// the distances from the last, so the landmarks are taken one at a time
+// (with a parallel search from each); those searches fill in the "from"
+// half of the table.  The searches for the "to" half are independent,
+// so they run at the same time, one landmark per thread.
+{
+	landmarks.assign(k, -1);
+	table.assign((size_t)2*k*n, InfiniteDistance);
+	if (k == 0)
+		return;
+
+	vector<double> d;
+	vector<int> p;
+	graph.parallel_shortest_paths(0, d, p, pool);
+	int next = farthest(d);
+
+	vector<double> closest(n, InfiniteDistance);
+	for (int l = 0; l < k; l++) {
+		landmarks[l] = next;
+		graph.parallel_shortest_paths(next, d, p, pool);
+		for (int v = 0; v < n; v++) {
+			table[(size_t)2*k*v + l] = d[v];
+			if (d[v] < closest[v])
+				closest[v] = d[v];
+		}
+		next = farthest(closest);
+	}
+
+	graph.update_incoming();
+	atomic<int> next_landmark(0);
+	pool.run([&](int) {
+		IndexedHeap heap(n);
+		vector<double> to;
+		for (int l = next_landmark++; l < k; l = next_landmark++) {
+			reverse_dijkstra(graph, landmarks[l], to, heap);
+			for (int v = 0; v < n; v++)
+				table[(size_t)2*k*v + k + l] = to[v];
+		}
+	});
+}
+
+Landmarks::~Landmarks()
+{
+	delete heap;
+}
+
+
+/***********/
+/* Queries */
+/***********/
+
+void Landmarks::init_queries()
+// Sets up the query state for 'n' nodes
+{
+	dist.assign(n, InfiniteDistance);
+	bound.assign(n, -1);
+	parent.assign(n, -1);
+	touched.clear();
+	heap = new IndexedHeap(n);
+}
+
+double Landmarks::lower_bound(int v, int t) const
+// Returns the largest of the triangle inequality bounds over all the
+// landmarks (see "Landmarks.h").  If 'v' reaches a landmark that 't'
+// doesn't, or vice versa, 'v' can't reach 't' and the bound is infinite.
+{
+	const double *from_v = table.data() + (size_t)2*k*v;
+	const double *from_t = table.data() + (size_t)2*k*t;
+	const double *to_v = from_v + k;
+	const double *to_t = from_t + k;
+
+	double best = 0;
+	for (int l = 0; l < k; l++) {
+		// dist(v, t) >= dist(L, t) - dist(L, v)
+		if (from_v[l] != InfiniteDistance) {
+			if (from_t[l] == InfiniteDistance)
+				return InfiniteDistance;
+			if (from_t[l] - from_v[l] > best)
+				best = from_t[l] - from_v[l];
+		}
+		// dist(v, t) >= dist(v, L) - dist(t, L)
+		if (to_t[l] != InfiniteDistance) {
+			if (to_v[l] == InfiniteDistance)
+				return InfiniteDistance;
+			if (to_v[l] - to_t[l] > best)
+				best = to_v[l] - to_t[l];
+		}
+	}
+	return best;
+}
+
+ShortestPath Landmarks::query(int source_i, int dest_i)
+// A* search from 'source_i', keyed by the distance plus the landmark
+// bound to 'dest_i'.  The bounds are consistent, so the search can stop
+// when 'dest_i' is removed from the queue; a node that can't reach
+// 'dest_i' is never queued at all.
+{
+	ShortestPath result;
+	if (!check_index(source_i, n, "query() (source index)"))
+		return result;
+	if (!check_index(dest_i, n, "query() (destination index)"))
+		return result;
+
+	// reset what the last query set
+	for (size_t h = 0; h < touched.size(); h++) {
+		dist[touched[h]] = InfiniteDistance;
+		bound[touched[h]] = -1;
+		parent[touched[h]] = -1;
+	}
+	touched.clear();
+	heap->clear();
+
+	dist[source_i] = 0;
+	bound[source_i] = lower_bound(source_i, dest_i);
+	touched.push_back(source_i);
+	if (bound[source_i] != InfiniteDistance)
+		heap->push(source_i, bound[source_i]);
+
+	while (!heap->empty()) {
+		int u = heap->pop();
+		result.settled++;
+		if (u == dest_i)
+			break;
+
+		for (int a = graph.first_arc(u); a < graph.last_arc(u); a++) {
+			int v = graph.arc_target(a);
+			double d = dist[u] + graph.arc_weight(a);
+			if (d < dist[v]) {
+				if (bound[v] < 0) {
+					bound[v] = lower_bound(v, dest_i);
+					touched.push_back(v);
+				}
+				if (bound[v] == InfiniteDistance)
+					continue;
+				// (a node may be reopened if rounding made the bounds
+				// slightly inconsistent)
+				dist[v] = d;
+				parent[v] = u;
+				heap->push_or_decrease(v, d + bound[v]);
+			}
+		}
+	}
+
+	result.distance = dist[dest_i];
+	if (result.distance == InfiniteDistance)
+		return result;
+	for (int v = dest_i; v != -1; v = parent[v])
+		result.path.push_back(v);
+	reverse(result.path.begin(), result.path.end());
+	return result;
+}
+
+
+/****************/
+/* Input/Output */
+/****************/
+
+Landmarks::Landmarks(Graph& graph, const string& filename)
+	: graph(graph), n(graph.node_count()), k(0)
+// Reads the tables saved in 'filename', which must be for 'graph'
+{
+	ifstream in(filename.c_str(), ios::binary);
+	if (!in) {
+		cerr << "Can't read from " << filename << ".  Exiting.\n";
+		exit(1);
+	}
+	read(in, filename);
+	init_queries();
+}
+
+void Landmarks::read(istream& in, const string& source_name)
+// Reads the tables in the format described in "Landmarks.h" from 'in'.
+// As with 'Graph::read', errors in the input are reported with the
+// 'source_name', and the program exits.
+{
+	string magic;
+	in >> magic;
+	if (magic != "Landmarks") {
+		cerr << "input source '" << source_name
+			<< "' is not in Landmarks format\n";
+		exit(1);
+	}
+	int n_nodes;
+	in >> n_nodes >> k;
+	if (!in || n_nodes != n || k < 0 || k > n) {
+		cerr << source_name << ":2 error: the tables are for "
+			<< n_nodes << " nodes, but the graph has " << n << endl;
+		exit(1);
+	}
+
+	landmarks.assign(k, -1);
+	for (int l = 0; l < k; l++) {
+		int index;
+		in >> index;
+		if (!in || !check_node_index(index, n, source_name, 3))
+			exit(1);
+		landmarks[l] = index - 1;
+	}
+
+	// the table follows the (single) newline that ends the landmark line
+	in.get();
+	table.assign((size_t)2*k*n, InfiniteDistance);
+	in.read((char *)table.data(), table.size()*sizeof(double));
+	if (!in) {
+		cerr << source_name << ": error: the distance table is incomplete\n";
+		exit(1);
+	}
+}
+
+ostream& Landmarks::write(ostream& out) const
+// Writes the tables in the format read by 'read'
+{
+	out << "Landmarks\n" << n << " " << k << "\n";
+	for (int l = 0; l < k; l++)
+		out << (l > 0 ? " " : "") << landmarks[l] + 1;
+	out << "\n";
+	out.write((const char *)table.data(), table.size()*sizeof(double));
+	return out;
+}
+
+bool Landmarks::save(const string& filename) const
+// Writes the tables to 'filename'.  Returns false if the file can't
+// be written.
+{
+	ofstream out(filename.c_str(), ios::binary);
+	if (!out) {
+		cerr << "Can't write to " << filename << endl;
+		return false;
+	}
+	write(out);
+	return (bool)out;
+}
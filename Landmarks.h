@@ -0,0 +1,94 @@
+/*
+ * File:   Landmarks.h
+ * Author: bret and daniel
+ *
+ * ALT (A*, landmarks, and the triangle inequality) point-to-point
+ * queries.  A few "landmark" nodes are chosen, and the distances from
+ * each landmark to every node and from every node to each landmark are
+ * computed once.  For any landmark L, the triangle inequality gives
+ *
+ *   dist(v, t) >= dist(L, t) - dist(L, v)
+ *   dist(v, t) >= dist(v, L) - dist(t, L)
+ *
+ * and the largest of these bounds guides an A* search to 't'.  Unlike
+ * 'Graph::astar_path', this needs no node positions, and the bounds are
+ * tight wherever a landmark lies "behind" the source or the destination.
+ *
+ * The landmarks and their tables can be written to a file and read
+ * back, so they only have to be computed once.  The file starts with
+ * three lines of text,
+ *
+ *   Landmarks
+ *   <number-of-nodes> <number-of-landmarks>
+ *   <landmark-1> ... <landmark-k>
+ *
+ * (node indices start at 1, as in the Graph format), followed by the
+ * table itself as raw 'double' values in the order described below.
+ * Reading the table back is much faster than parsing it from text,
+ * but the file is only good on machines with the same 'double' format.
+ */
+
+#ifndef __LANDMARKS_H
+#define __LANDMARKS_H
+
+#include <string>
+#include <iostream>
+#include <vector>
+
+#include "Graph.h"
+#include "IndexedHeap.h"
+
+using namespace std;
+
+class ThreadPool;
+
+class Landmarks {
+ public:
+
+  /* Constructors: the queries run on 'graph', which must outlive this
+   * object and keep its arcs */
+  Landmarks( Graph& graph, int n_landmarks, ThreadPool& pool );
+  Landmarks( Graph& graph, const string& filename );  // reads saved tables
+  ~Landmarks();
+
+  int count() const { return k; }                   // number of landmarks
+  int landmark( int l ) const { return landmarks[l]; }
+
+  // A lower bound on the distance from 'v' to 't'
+  double lower_bound( int v, int t ) const;
+
+  // The shortest path from 'source_i' to 'dest_i'
+  ShortestPath query( int source_i, int dest_i );
+
+  /* Output */
+  ostream& write( ostream& out ) const;
+  bool save( const string& filename ) const;
+
+ private:
+  Graph& graph;
+  int n;
+  int k;
+  vector<int> landmarks;
+
+  // The distances for node 'v' are together, so a query touches one
+  // stretch of memory per node: dist(L_l, v) is table[2*k*v + l], and
+  // dist(v, L_l) is table[2*k*v + k + l]
+  vector<double> table;
+
+  // Query state, reused from one query to the next
+  vector<double> dist;
+  vector<double> bound;     // lower bound to the destination, or -1
+  vector<int> parent;
+  vector<int> touched;      // nodes whose 'dist' is set
+  IndexedHeap *heap;
+
+  void select( ThreadPool& pool );
+  void read( istream& in, const string& source_name );
+  void init_queries();
+
+  // (not copyable)
+  Landmarks( const Landmarks& );
+  Landmarks& operator=( const Landmarks& );
+};
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * File:   MultiSourceBFS.h
+ * Author: bret and daniel
+ *
+ * Multi-source breadth-first search (MS-BFS): up to 64, 256, or 512
+ * breadth-first traversals from different start nodes, run together.
+ *
+ * Each node has a set of bits, one per source: the sources that have
+ * "seen" it, and the sources whose frontier it is on.  A level of all
+ * the traversals at once is then one scan of the frontier nodes' arcs,
+ * OR-ing each node's frontier bits into its neighbors, followed by an
+ * AND-NOT against the "seen" bits to drop the sources that already got
+ * there.  A node reached by many of the traversals at the same level
+ * has its arcs scanned once instead of once per traversal.  The bit
+ * sets are a few 64-bit words, and the loops over them are simple
+ * enough for the compiler to turn into vector instructions.
+ *
+ * For example, hop distances from 256 sources:
+ *
+ *   MultiSourceBFS<4> bfs(graph);
+ *   bfs.run(sources, &hops);   // hops[s*n + v], or -1 if not reached
+ */
+
+#ifndef __MULTISOURCEBFS_H
+#define __MULTISOURCEBFS_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "Graph.h"
+
+using namespace std;
+
+template <int Words>
+class MultiSourceBFS {
+ public:
+
+  static const int Width = 64*Words;  // number of sources per run
+
+  MultiSourceBFS( const Graph& graph ) : graph(graph), n(graph.node_count()),
+    seen(n), frontier(n), next(n) {}
+
+  // Runs the traversals from 'sources' (at most 'Width' of them).  If
+  // 'hops' is given, it is set to the number of arcs from each source
+  // 's' to each node 'v' at hops[s*n + v] (or -1 if 'v' isn't reached).
+  void run( const vector<int>& sources, vector<int> *hops = NULL );
+
+  // True if the last run reached 'v' from source number 's'
+  bool reached( int s, int v ) const {
+    return (seen[v].word[s >> 6] >> (s & 63)) & 1;
+  }
+
+  int depth() const { return max_hops; }  // farthest hops in the last run
+
+ private:
+
+  // A set of sources, one bit each
+  struct Bits {
+    uint64_t word[Words];
+
+    void clear() {
+      for (int k = 0; k < Words; k++)
+	word[k] = 0;
+    }
+    bool empty() const {
+      uint64_t any = 0;
+      for (int k = 0; k < Words; k++)
+	any |= word[k];
+      return any == 0;
+    }
+  };
+
+  const Graph& graph;
+  int n;
+  int max_hops;
+  vector<Bits> seen;      // sources that have reached each node
+  vector<Bits> frontier;  // sources whose current level has each node
+  vector<Bits> next;      // sources whose next level has each node
+};
+
+template <int Words>
+void MultiSourceBFS<Words>::run(const vector<int>& sources, vector<int> *hops)
+{
+  const int n_sources = (int)sources.size();
+  if (n_sources > Width) {
+    cerr << "MultiSourceBFS::run(): " << n_sources << " sources, but at most "
+	 << Width << " fit in a run\n";
+    return;
+  }
+
+  for (int v = 0; v < n; v++) {
+    seen[v].clear();
+    frontier[v].clear();
+    next[v].clear();
+  }
+  if (hops)
+    hops->assign((size_t)n_sources*n, -1);
+
+  // 'active' lists the nodes on some frontier, 'touched' the nodes on
+  // some next frontier (before the ones already seen are dropped)
+  vector<int> active, touched;
+  for (int s = 0; s < n_sources; s++) {
+    int v = sources[s];
+    uint64_t bit = (uint64_t)1 << (s & 63);
+    if (frontier[v].empty())
+      active.push_back(v);
+    seen[v].word[s >> 6] |= bit;
+    frontier[v].word[s >> 6] |= bit;
+    if (hops)
+      (*hops)[(size_t)s*n + v] = 0;
+  }
+
+  max_hops = 0;
+  for (int level = 1; !active.empty(); level++) {
+
+    // OR each frontier into the neighbors' next frontiers
+    for (size_t f = 0; f < active.size(); f++) {
+      int v = active[f];
+      const Bits& from = frontier[v];
+      for (int a = graph.first_arc(v); a < graph.last_arc(v); a++) {
+	Bits& to = next[graph.arc_target(a)];
+	if (to.empty())
+	  touched.push_back(graph.arc_target(a));
+	for (int k = 0; k < Words; k++)
+	  to.word[k] |= from.word[k];
+      }
+    }
+    for (size_t f = 0; f < active.size(); f++)
+      frontier[active[f]].clear();
+    active.clear();
+
+    // keep only the sources that haven't been to each node before
+    for (size_t t = 0; t < touched.size(); t++) {
+      int v = touched[t];
+      Bits& bits = next[v];
+      for (int k = 0; k < Words; k++) {
+	bits.word[k] &= ~seen[v].word[k];
+	seen[v].word[k] |= bits.word[k];
+      }
+      if (bits.empty())
+	continue;
+
+      frontier[v] = bits;
+      bits.clear();
+      active.push_back(v);
+      if (!hops)
+	continue;
+      for (int k = 0; k < Words; k++)
+	for (uint64_t w = frontier[v].word[k]; w != 0; w &= w - 1)
+	  (*hops)[(size_t)(64*k + lowest_bit(w))*n + v] = level;
+    }
+    touched.clear();
+    if (!active.empty())
+      max_hops = level;
+  }
+}
+
+#endif
@@ -12,6 +12,7 @@
 
 #include "PDFGraph.h"
 #include "Graph.h"
+#include "Subgraph.h"
 
 /****************************************************************************/
 /***                       PDFGraph Implementation						  ***/
@@ -69,13 +70,9 @@ void PDFGraph::setup()
 	}
 
 	// add the arc points (if there are any) to the bounding box
-	for (int i = 0; i < n; i++) {
-		for (int j = 0; j < n; j++) {
-			if (graph->arc_pos[i][j]) {
-				update_bbox(x0, y0, x1, y1,
-					graph->arc_pos[i][j]->x, graph->arc_pos[i][j]->y);
-			}
-		}
+	for (size_t k = 0; k < graph->arc_points.size(); k++) {
+		update_bbox(x0, y0, x1, y1,
+			graph->arc_points[k].p.x, graph->arc_points[k].p.y);
 	}
 
 	// add a margin to the bounding box (10%)
@@ -106,14 +103,50 @@ void PDFGraph::draw_general(const Graph *src,
 	int arc_font, double arc_font_scale)
 	// General draw function
 {
-	static char buf[256];  // for the text in the nodes
-
 	// if 'src' is NULL, use the 'graph' of this
 	if (src == NULL)
 		src = graph;
 
+	draw_layers(src, src, flags, node_color, arc_color, node_r,
+		node_line_width, arc_line_width, arrowhead_length, arrowhead_width,
+		node_font, node_font_scale, arc_font, arc_font_scale);
+}
+
+void PDFGraph::draw_general(const Subgraph *src,
+	unsigned flags,
+	const PDFColor& node_color,
+	const PDFColor& arc_color,
+	double node_r, double node_line_width,
+	double arc_line_width,
+	double arrowhead_length, double arrowhead_width,
+	int node_font, double node_font_scale,
+	int arc_font, double arc_font_scale)
+	// The same, for a view: the nodes are those of its parent
+{
+	draw_layers(&src->parent(), src, flags, node_color, arc_color, node_r,
+		node_line_width, arc_line_width, arrowhead_length, arrowhead_width,
+		node_font, node_font_scale, arc_font, arc_font_scale);
+}
+
+template <class Arcs>
+void PDFGraph::draw_layers(const Graph *nodes, const Arcs *src,
+	unsigned flags,
+	const PDFColor& node_color,
+	const PDFColor& arc_color,
+	double node_r, double node_line_width,
+	double arc_line_width,
+	double arrowhead_length, double arrowhead_width,
+	int node_font, double node_font_scale,
+	int arc_font, double arc_font_scale)
+	// Does the work of 'draw_general', drawing the nodes (and taking the
+	// node positions and arc points) from 'nodes', and the arcs from 'src'
+	// (which is 'nodes' itself, or a view of it)
+{
+	static char buf[256];  // for the text in the nodes
+
 	// for convenience, copy 'n' from the graph
-	int n = src->n;
+	int n = nodes->n;
+	nodes->clear_stale_fields();
 
 	// if thick arcs are requested, adjust the size of the arc line width
 	// and arrowhead dimensions
@@ -133,10 +166,10 @@ void PDFGraph::draw_general(const Graph *src,
 		setlinewidth(node_line_width);
 		setcolor(node_color);
 		for (int i = 0; i < n; i++) {
-			PDFPoint p = gtransform(src->node_pos[i].x, src->node_pos[i].y);
+			PDFPoint p = gtransform(nodes->node_pos[i].x, nodes->node_pos[i].y);
 
 			// highlight the node, if the Highlight flag is set
-			if (src->nodes[i].flags & HighlightFlag) {
+			if (nodes->node_flags[i] & HighlightFlag) {
 				setcolor(PDFColor(1.0, 1.0, 0.5));
 				circle_path(p.x, p.y, 1.618*node_r);
 				fill();
@@ -146,11 +179,11 @@ void PDFGraph::draw_general(const Graph *src,
 			// draw the node, as usual
 			circle_path(p.x, p.y, node_r);
 			// the fill color is set according to the state
-			if (src->nodes[i].state == Active)
+			if (nodes->node_states[i] == Active)
 				setcolor_nonstroke(PDFColor(0.9));
-			else if (src->nodes[i].state == Finished)
+			else if (nodes->node_states[i] == Finished)
 				setcolor_nonstroke(PDFColor(0.5));
-			else if (src->nodes[i].state == Visited)
+			else if (nodes->node_states[i] == Visited)
 				setcolor_nonstroke(PDFColor(0.75));
 			else
 				setcolor_nonstroke(PDFColor(1));
@@ -161,7 +194,7 @@ void PDFGraph::draw_general(const Graph *src,
 				setcolor_nonstroke(node_color);
 				if (flags & ShowNodeValues) {
 					selectfont(Helvetica | BoldFlag, ArcFontScale);
-					sprintf(buf, "%.2g", src->nodes[i].value);
+					sprintf(buf, "%.2g", nodes->node_values[i]);
 					position_text(buf, p.x, p.y, 0.5, 0.5);
 				}
 				else {
@@ -175,51 +208,50 @@ void PDFGraph::draw_general(const Graph *src,
 
 	// draw all the arcs
 	if (!(flags & NoArcs)) {
-		int heads = (src->directed ? Forward : 0);
+		int heads = (src->is_directed() ? Forward : 0);
 		setlinewidth(arc_line_width);
 		setcolor(arc_color);
 		for (int i = 0; i < n; i++) {
-			for (int j = 0; j < n; j++) {
-				if (src->adj[i][j] > 0) {
-					PDFPoint p0 = gtransform(src->node_pos[i].x, src->node_pos[i].y);
-					PDFPoint p1 = gtransform(src->node_pos[j].x, src->node_pos[j].y);
-					// if no arc point is specified, just draw a line
-					if (!src->arc_pos[i][j]) {
+			for (int a = src->first_arc(i); a < src->last_arc(i); a++) {
+				int j = src->arc_target(a);
+				const PDFPoint *arc_pos = nodes->arc_point(i, j);
+				PDFPoint p0 = gtransform(nodes->node_pos[i].x, nodes->node_pos[i].y);
+				PDFPoint p1 = gtransform(nodes->node_pos[j].x, nodes->node_pos[j].y);
+				// if no arc point is specified, just draw a line
+				if (!arc_pos) {
+					arrowed_line(p0.x, p0.y, p1.x, p1.y,
+						arrowhead_length, arrowhead_width, heads,
+						node_r, node_r);
+				}
+				else {
+					// otherwise construct a circular arc for the arc line
+					PDFPoint p2 = gtransform(arc_pos->x, arc_pos->y);
+					const double c1 = (p1.length_sqr() - p0.length_sqr()) / 2;
+					const double c2 = (p2.length_sqr() - p1.length_sqr()) / 2;
+					const PDFPoint d1 = p1 - p0;
+					const PDFPoint d2 = p2 - p1;
+
+					const double D = d1.x*d2.y - d1.y*d2.x;
+					if (fabs(D) == 1E-6) {
+						// it degenerates to a line
 						arrowed_line(p0.x, p0.y, p1.x, p1.y,
 							arrowhead_length, arrowhead_width, heads,
 							node_r, node_r);
 					}
 					else {
-						// otherwise construct a circular arc for the arc line
-						PDFPoint p2 = gtransform(src->arc_pos[i][j]->x,
-							src->arc_pos[i][j]->y);
-						const double c1 = (p1.length_sqr() - p0.length_sqr()) / 2;
-						const double c2 = (p2.length_sqr() - p1.length_sqr()) / 2;
-						const PDFPoint d1 = p1 - p0;
-						const PDFPoint d2 = p2 - p1;
-
-						const double D = d1.x*d2.y - d1.y*d2.x;
-						if (fabs(D) == 1E-6) {
-							// it degenerates to a line
-							arrowed_line(p0.x, p0.y, p1.x, p1.y,
+						PDFPoint c((c1*d2.y - c2*d1.y) / D, -(c1*d2.x - c2*d1.x) / D);
+						double r = c.dist(p0);
+						double a0 = atan2(p0.y - c.y, p0.x - c.x);
+						double a1 = atan2(p1.y - c.y, p1.x - c.x);
+						if ((p0 - c).cross_z(p1 - c) < 0) {
+							arrowed_arcn(c.x, c.y, r, a0, a1,
 								arrowhead_length, arrowhead_width, heads,
 								node_r, node_r);
 						}
 						else {
-							PDFPoint c((c1*d2.y - c2*d1.y) / D, -(c1*d2.x - c2*d1.x) / D);
-							double r = c.dist(p0);
-							double a0 = atan2(p0.y - c.y, p0.x - c.x);
-							double a1 = atan2(p1.y - c.y, p1.x - c.x);
-							if ((p0 - c).cross_z(p1 - c) < 0) {
-								arrowed_arcn(c.x, c.y, r, a0, a1,
-									arrowhead_length, arrowhead_width, heads,
-									node_r, node_r);
-							}
-							else {
-								arrowed_arc(c.x, c.y, r, a0, a1,
-									arrowhead_length, arrowhead_width, heads,
-									node_r, node_r);
-							}
+							arrowed_arc(c.x, c.y, r, a0, a1,
+								arrowhead_length, arrowhead_width, heads,
+								node_r, node_r);
 						}
 					}
 				}
@@ -232,55 +264,55 @@ void PDFGraph::draw_general(const Graph *src,
 		selectfont(Helvetica, ArcFontScale);
 		double label_offset = 3;
 		for (int i = 0; i < n; i++) {
-			for (int j = 0; j < n; j++) {
-				if (src->adj[i][j] > 0) {
-					PDFPoint mid;
-					if (src->arc_pos[i][j])
-						// if an arc point is given, start from there	    
-						mid = *src->arc_pos[i][j];
-					else
-						// otherwise use the midpoint
-						mid = 0.5*(src->node_pos[i] + src->node_pos[j]);
-					mid = gtransform(mid.x, mid.y);
-
-					// find the best placement based on the angle of the perpendicular
-					PDFPoint perp =
-						(src->node_pos[i] - src->node_pos[j]).perp().unit();
-					double angle = atan2(perp.y, perp.x);
-					double h_frac = 0;
-					double v_frac = 0;
-					if (angle < -3 * M_PI / 4) {
-						double t = (angle + 5 * M_PI / 4) / (M_PI / 2);  // 0.5 <= t < 1
-						h_frac = 1;
-						v_frac = t;
-					}
-					else if (angle < -M_PI / 4) {
-						double t = (angle + 3 * M_PI / 4) / (M_PI / 2);
-						h_frac = 1 - t;
-						v_frac = 1;
-					}
-					else if (angle < M_PI / 4) {
-						double t = (angle + M_PI / 4) / (M_PI / 2);
-						h_frac = 0;
-						v_frac = 1 - t;
-					}
-					else if (angle < 3 * M_PI / 4) {
-						double t = (angle - M_PI / 4) / (M_PI / 2);
-						h_frac = t;
-						v_frac = 0;
-					}
-					else {
-						double t = (angle - 5 * M_PI / 4) / (M_PI / 2);
-						h_frac = 1;
-						v_frac = t;
-					}
-
-					// display the text
-					mid = mid + label_offset*perp;
-					sprintf(buf, "%.2g", graph->adj[i][j]);
-					position_text(buf, mid.x, mid.y, h_frac, v_frac);
-					//circle_path(mid.x, mid.y, 3); fill();
+			for (int a = src->first_arc(i); a < src->last_arc(i); a++) {
+				int j = src->arc_target(a);
+				const PDFPoint *arc_pos = nodes->arc_point(i, j);
+				PDFPoint mid;
+				if (arc_pos)
+					// if an arc point is given, start from there	    
+					mid = *arc_pos;
+				else
+					// otherwise use the midpoint
+					mid = 0.5*(nodes->node_pos[i] + nodes->node_pos[j]);
+				mid = gtransform(mid.x, mid.y);
+
+				// find the best placement based on the angle of the perpendicular
+				PDFPoint perp =
+					(nodes->node_pos[i] - nodes->node_pos[j]).perp().unit();
+				double angle = atan2(perp.y, perp.x);
+				double h_frac = 0;
+				double v_frac = 0;
+				if (angle < -3 * M_PI / 4) {
+					double t = (angle + 5 * M_PI / 4) / (M_PI / 2);  // 0.5 <= t < 1
+					h_frac = 1;
+					v_frac = t;
+				}
+				else if (angle < -M_PI / 4) {
+					double t = (angle + 3 * M_PI / 4) / (M_PI / 2);
+					h_frac = 1 - t;
+					v_frac = 1;
 				}
+				else if (angle < M_PI / 4) {
+					double t = (angle + M_PI / 4) / (M_PI / 2);
+					h_frac = 0;
+					v_frac = 1 - t;
+				}
+				else if (angle < 3 * M_PI / 4) {
+					double t = (angle - M_PI / 4) / (M_PI / 2);
+					h_frac = t;
+					v_frac = 0;
+				}
+				else {
+					double t = (angle - 5 * M_PI / 4) / (M_PI / 2);
+					h_frac = 1;
+					v_frac = t;
+				}
+
+				// display the text
+				mid = mid + label_offset*perp;
+				sprintf(buf, "%.2g", src->arc_weight(a));
+				position_text(buf, mid.x, mid.y, h_frac, v_frac);
+				//circle_path(mid.x, mid.y, 3); fill();
 			}
 		}
 	}
@@ -309,3 +341,15 @@ void PDFGraph::draw_beneath(unsigned flags, const Graph *src)
 	draw_general(src, display_flags | flags | local_flags,
 		NodeColor, PDFColor(0.5, 0.5, 1.0));
 }
+
+void PDFGraph::draw_beneath(unsigned flags, const Subgraph *src)
+// The same, for the arcs of a view of the graph
+{
+	unsigned local_flags =
+		(src->is_weighted() ? ArcWeights : 0) |
+		(src->is_directed() ? 0 : NoArcArrows) |
+		ThickArcs | NoNodes;
+
+	draw_general(src, display_flags | flags | local_flags,
+		NodeColor, PDFColor(0.5, 0.5, 1.0));
+}
@@ -14,6 +14,7 @@
 #include "PDF.h"
 
 class Graph;
+class Subgraph;
 
 /****************************************************************************
  *
@@ -91,8 +92,22 @@ public:
 		double node_font_scale = NodeFontScale,
 		int arc_font = ArcFont,
 		double arc_font_scale = ArcFontScale);
+	void draw_general(const Subgraph *src,
+		unsigned flags,
+		const PDFColor& node_color,
+		const PDFColor& arc_color,
+		double node_r = NodeRadius,
+		double node_line_width = NodeLineWidth,
+		double arc_line_width = ArcLineWidth,
+		double arrowhead_length = ArrowheadLength,
+		double arrowhead_width = ArrowheadWidth,
+		int node_font = NodeFont,
+		double node_font_scale = NodeFontScale,
+		int arc_font = ArcFont,
+		double arc_font_scale = ArcFontScale);
 	void draw(unsigned flags = 0, const Graph* src = NULL);
 	void draw_beneath(unsigned flags, const Graph *src = NULL);
+	void draw_beneath(unsigned flags, const Subgraph *src);
 
 	// Convenience functions for setting the drawing state
 	void show_node_values() { display_flags |= ShowNodeValues; }
@@ -121,6 +136,18 @@ private:
 	// Initialization stuff
 	void setup();
 
+	// The body of 'draw_general', for the arcs of a graph or a view
+	template <class Arcs>
+	void draw_layers(const Graph *nodes, const Arcs *src,
+		unsigned flags,
+		const PDFColor& node_color,
+		const PDFColor& arc_color,
+		double node_r, double node_line_width,
+		double arc_line_width,
+		double arrowhead_length, double arrowhead_width,
+		int node_font, double node_font_scale,
+		int arc_font, double arc_font_scale);
+
 };
 
 
@@ -0,0 +1,165 @@
+/*
+ * File:   Subgraph.cpp
+ * Author: bret and daniel
+ */
+
+#include <algorithm>
+
+#include "Subgraph.h"
+
+using namespace std;
+
+bool check_index(int i, int n, const char *msg);
+
+/****************/
+/* Construction */
+/****************/
+
+Subgraph::Subgraph(const Graph& parent, bool with_arcs)
+	: graph(&parent), weighted(false)
+{
+	if (!with_arcs)
+		return;
+
+	// the rows of the parent are already in (start, end) order
+	arcs.reserve(parent.m);
+	for (int i = 0; i < parent.n; i++)
+		for (int a = parent.first_arc(i); a < parent.last_arc(i); a++) {
+			Graph::ArcRecord arc = { i, parent.arc_target(a),
+				parent.arc_weight(a) };
+			arcs.push_back(arc);
+		}
+	weighted = parent.weighted;
+}
+
+
+/********/
+/* Arcs */
+/********/
+
+int Subgraph::lower_row(int i) const
+// Returns the index of the first arc that starts at node 'i' or later
+{
+	Graph::ArcRecord key = { i, -1, 0 };
+	return (int)(lower_bound(arcs.begin(), arcs.end(), key) - arcs.begin());
+}
+
+int Subgraph::find_arc(int i, int j) const
+// Returns the index of the arc i->j, or of the arc it would go before
+{
+	Graph::ArcRecord key = { i, j, 0 };
+	return (int)(lower_bound(arcs.begin(), arcs.end(), key) - arcs.begin());
+}
+
+bool Subgraph::adjacent(int i, int j) const
+// Returns true if there is an arc i->j
+{
+	if (!check_index(i, node_count(), "adjacent() (start index)"))
+		return false;
+	if (!check_index(j, node_count(), "adjacent() (end index)"))
+		return false;
+
+	int a = find_arc(i, j);
+	return (a < arc_count() && arcs[a].start == i && arcs[a].end == j);
+}
+
+bool Subgraph::add_arc(int i, int j, double weight)
+// Adds the arc i->j having weight 'weight'
+// Returns true if this arc existed before the call, and false otherwise
+{
+	// check the indices
+	if (!check_index(i, node_count(), "add_arc() (start index)"))
+		return false;
+	if (!check_index(j, node_count(), "add_arc() (end index)"))
+		return false;
+
+	// check the weight
+	if (weight <= 0) {
+		cerr << "add_arc(): negative weight " << weight << endl;
+		weight = 1;
+	}
+
+	int a = find_arc(i, j);
+	if (a < arc_count() && arcs[a].start == i && arcs[a].end == j) {
+		arcs[a].weight = weight;
+		return true;
+	}
+	else {
+		Graph::ArcRecord arc = { i, j, weight };
+		arcs.insert(arcs.begin() + a, arc);
+		return false;
+	}
+}
+
+bool Subgraph::remove_arc(int i, int j)
+// Removes the arc i->j
+// Returns true if this arc existed before the call, and false otherwise
+{
+	if (!adjacent(i, j))
+		return false;
+	arcs.erase(arcs.begin() + find_arc(i, j));
+	return true;
+}
+
+void Subgraph::remove_outgoing_arcs(int i)
+// Removes all the outgoing arcs for node 'i'
+{
+	if (!check_index(i, node_count(), "remove_outgoing_arcs()"))
+		return;
+	arcs.erase(arcs.begin() + first_arc(i), arcs.begin() + last_arc(i));
+}
+
+void Subgraph::remove_all_arcs()
+// Removes all the arcs in this view
+{
+	arcs.clear();
+}
+
+void Subgraph::set_tree_arcs(const vector<int>& parent)
+// Replaces the arcs with k->parent[k] for each node 'k' that has a
+// parent; they come out in order, so there is nothing to sort
+{
+	arcs.clear();
+	for (int k = 0; k < node_count(); k++)
+		if (parent[k] >= 0) {
+			Graph::ArcRecord arc = { k, parent[k], 1 };
+			arcs.push_back(arc);
+		}
+}
+
+
+/**********/
+/* Output */
+/**********/
+
+ostream& Subgraph::write(ostream& out, bool brief, const string &prefix) const
+// Writes this view in the Graph format (see 'Graph::write'): the nodes
+// of the parent, and the arcs of this
+{
+	graph->write_nodes(out, brief, prefix);
+
+	// write the arcs
+	for (size_t a = 0; a < arcs.size(); a++) {
+		if (weighted)
+			out << prefix << "weighted_arc " << (arcs[a].start + 1) << " "
+			<< (arcs[a].end + 1) << " " << arcs[a].weight << "\n";
+		else
+			out << prefix << "arc " << (arcs[a].start + 1) << " "
+			<< (arcs[a].end + 1) << "\n";
+	}
+
+	if (!brief)
+		graph->write_layout(out, prefix);
+	return out;
+}
+
+Graph *Subgraph::to_graph() const
+// Returns a newly created graph with the nodes of the parent and the
+// arcs of this view
+{
+	Graph *result = graph->node_subgraph();
+	vector<Graph::ArcRecord> records(arcs);
+	result->build_arcs(records);
+	result->weighted = weighted;
+	return result;
+}
@@ -0,0 +1,86 @@
+/*
+ * File:   Subgraph.h
+ * Author: bret and daniel
+ *
+ * A subgraph "view": the nodes of a parent graph, with arcs of its own.
+ * The node arrays (names, states, values, and positions) are read from
+ * the parent in place, so making a view copies nothing, and the only
+ * memory it takes is for its arcs.  The spanning trees the traversals
+ * draw beneath the graph are views; they used to be full copies of the
+ * graph ('Graph::node_subgraph') with the arcs removed again.
+ *
+ * The arcs are kept in one list sorted by (start, end), so a view with
+ * k arcs takes O(k) memory however large its parent is.  The arcs of a
+ * node are found by a binary search of the list, and adding or removing
+ * an arc moves the arcs after it, which suits the small subgraphs views
+ * are meant for (trees, paths, and the like).  A view can also start out
+ * with all the arcs of its parent, as an overlay for changing the arcs
+ * without touching the parent.
+ *
+ * The arcs are iterated just as those of a 'Graph' are, so a view can
+ * be drawn ('PDFGraph::draw_beneath') and written ('write') directly;
+ * 'to_graph' makes a separate graph of it when one is needed.  A view
+ * must not outlive its parent, and sees any change to the parent's nodes.
+ */
+
+#ifndef __SUBGRAPH_H
+#define __SUBGRAPH_H
+
+#include <string>
+#include <iostream>
+#include <vector>
+
+#include "Graph.h"
+
+using namespace std;
+
+class Subgraph {
+ public:
+
+  /* Constructor: a view of the nodes of 'parent', with no arcs, or with
+   * a copy of the arcs of 'parent' if 'with_arcs' is true */
+  Subgraph( const Graph& parent, bool with_arcs = false );
+
+  const Graph& parent() const { return *graph; }
+  bool is_weighted() const { return weighted; } // true if arcs are weighted
+  bool is_directed() const { return graph->is_directed(); }
+  int node_count() const { return graph->node_count(); }
+  int arc_count() const { return (int)arcs.size(); }
+  void set_weighted() { weighted = true; }
+  void set_unweighted() { weighted = false; }
+
+  /* Arcs (the indices are checked, as in 'Graph') */
+  bool adjacent( int i, int j ) const;       // true if there is an arc i->j
+  bool add_arc( int i, int j, double weight = 1 ); // true if it was there
+  bool remove_arc( int i, int j );           // true if it was there
+  void remove_outgoing_arcs( int i );
+  void remove_all_arcs();
+
+  // Replaces the arcs with the arcs k->parent[k] of a spanning tree
+  // (-1 for no parent), in one pass
+  void set_tree_arcs( const vector<int>& parent );
+
+  /* Neighbor iteration (Fast, unchecked), as in 'Graph': the arcs of
+   * node 'i' are first_arc(i) <= a < last_arc(i) */
+  int first_arc( int i ) const { return lower_row(i); }
+  int last_arc( int i ) const { return lower_row(i + 1); }
+  int arc_target( int a ) const { return arcs[a].end; }
+  double arc_weight( int a ) const { return arcs[a].weight; }
+
+  /* Text output, in the Graph format (with the parent's nodes) */
+  ostream& write( ostream& out, bool brief = false,
+		  const string &prefix = "" ) const;
+
+  // Returns a new graph with the nodes of the parent and the arcs of this
+  Graph *to_graph() const;
+
+ private:
+  const Graph *graph;
+  bool weighted;
+  vector<Graph::ArcRecord> arcs;  // sorted by (start, end)
+
+  int lower_row( int i ) const;      // index of the first arc from 'i' on
+  int find_arc( int i, int j ) const;  // index of i->j, or where it goes
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * File:   ThreadPool.cpp
+ * Author: bret and daniel
+ */
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int n_threads)
+	: task(NULL), generation(0), running(0), stopping(false)
+{
+	if (n_threads <= 0)
+		n_threads = (int)thread::hardware_concurrency();
+	if (n_threads <= 0)
+		n_threads = 1;
+
+	// the calling thread is thread 0, so start one fewer workers
+	for (int t = 1; t < n_threads; t++)
+		workers.push_back(thread(&ThreadPool::work, this, t));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		unique_lock<mutex> guard(lock);
+		stopping = true;
+	}
+	start_cv.notify_all();
+	for (size_t k = 0; k < workers.size(); k++)
+		workers[k].join();
+}
+
+void ThreadPool::run(const function<void(int)>& f)
+// Runs 'f' on every thread of the pool, and returns when all are done
+{
+	if (workers.empty()) {
+		f(0);
+		return;
+	}
+
+	{
+		unique_lock<mutex> guard(lock);
+		task = &f;
+		running = (int)workers.size();
+		generation++;
+	}
+	start_cv.notify_all();
+
+	f(0);
+
+	unique_lock<mutex> guard(lock);
+	while (running > 0)
+		done_cv.wait(guard);
+	task = NULL;
+}
+
+void ThreadPool::work(int t)
+// The loop each worker thread runs: wait for a task, run it, repeat
+{
+	unsigned long seen = 0;
+	for (;;) {
+		const function<void(int)> *f;
+		{
+			unique_lock<mutex> guard(lock);
+			while (!stopping && generation == seen)
+				start_cv.wait(guard);
+			if (stopping)
+				return;
+			seen = generation;
+			f = task;
+		}
+
+		(*f)(t);
+
+		unique_lock<mutex> guard(lock);
+		if (--running == 0)
+			done_cv.notify_one();
+	}
+}
@@ -0,0 +1,52 @@
+/*
+ * File:   ThreadPool.h
+ * Author: bret and daniel
+ *
+ * A fixed set of worker threads for the parallel graph algorithms.
+ * The pool runs one task at a time on every thread at once (the
+ * calling thread takes part as thread 0), and 'run' returns when all
+ * of them are done, so a sequence of 'run' calls acts as a sequence of
+ * parallel phases separated by barriers.
+ */
+
+#ifndef __THREADPOOL_H
+#define __THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+class ThreadPool {
+ public:
+
+  /* Constructor: 'n_threads' <= 0 means one per hardware thread */
+  ThreadPool( int n_threads = 0 );
+  ~ThreadPool();
+
+  int size() const { return (int)workers.size() + 1; }  // number of threads
+
+  // Calls 'task(t)' on each thread t = 0..size()-1 and waits for them all
+  void run( const function<void(int)>& task );
+
+ private:
+  vector<thread> workers;          // threads 1..size()-1
+  mutex lock;
+  condition_variable start_cv;     // signals a new task (or shutdown)
+  condition_variable done_cv;      // signals the last worker finishing
+  const function<void(int)> *task; // the current task
+  unsigned long generation;        // counts the tasks started
+  int running;                     // workers still on the current task
+  bool stopping;
+
+  void work( int t );
+
+  // (not copyable)
+  ThreadPool( const ThreadPool& );
+  ThreadPool& operator=( const ThreadPool& );
+};
+
+#endif
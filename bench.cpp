@@ -0,0 +1,1163 @@
+/*
+ * File:   bench.cpp
+ * Author: bret and daniel
+ *
+ * Timing driver for the graph algorithms.  Builds random graphs of a
+ * few sizes and reports how long each algorithm takes on them.
+ *
+ *   bench [nodes] [degree]
+ *
+ * This has its own 'main', so build it in place of test.cpp.
+ */
+
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_FORK
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+#include "Graph.h"
+#include "GraphVisitor.h"
+#include "ThreadPool.h"
+#include "ContractionHierarchy.h"
+#include "Landmarks.h"
+#include "AllPairs.h"
+
+using namespace std;
+
+// Returns the number of seconds since 'start'
+static double seconds_since(chrono::steady_clock::time_point start)
+{
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+// Returns true if the distances 'a' and 'b' are the same, but for
+// rounding (the same weights added up in another order can differ in
+// the last bits)
+static bool same_distance(double a, double b)
+{
+	return a == b || fabs(a - b) <= 1e-9*fmax(fabs(a), fabs(b));
+}
+
+// Reports that 'name' got a wrong answer, and exits
+static void check_failed(const char *name, const char *what, int v)
+{
+	fprintf(stderr, "%s: %s (node %d)\n", name, what, v);
+	exit(1);
+}
+
+// Checks the distances and shortest path tree 'dist' and 'parent' from
+// 'source_i' against the distances 'expected' found by Dijkstra's
+// algorithm: the distances must match, and each reached node's parent
+// must be joined to it by an arc that makes up its distance
+static void check_tree(const Graph *g, const char *name, int source_i,
+	const vector<double>& expected, const vector<double>& dist,
+	const vector<int>& parent)
+{
+	for (int v = 0; v < g->node_count(); v++) {
+		if (!same_distance(dist[v], expected[v]))
+			check_failed(name, "wrong distance", v);
+		int p = parent[v];
+		if (v == source_i || dist[v] == InfiniteDistance) {
+			if (p != -1)
+				check_failed(name, "parent of the source or an unreached node",
+					v);
+			continue;
+		}
+		if (p < 0 || !g->adjacent(p, v))
+			check_failed(name, "parent is not joined by an arc", v);
+		if (!same_distance(dist[p] + g->get_arc_weight(p, v), dist[v]))
+			check_failed(name, "parent arc is not on a shortest path", v);
+	}
+}
+
+// Checks the answer of 'name' to the query from 's' to 't' against the
+// distance 'expected' found by Dijkstra's algorithm: the distances must
+// match, and 'path' must run from 's' to 't' over arcs that add up to
+// it (or be empty, if there is no path)
+static void check_path(const Graph *g, const char *name, int s, int t,
+	double expected, double distance, const vector<int>& path)
+{
+	if (!same_distance(distance, expected))
+		check_failed(name, "wrong distance", t);
+	if (expected == InfiniteDistance) {
+		if (!path.empty())
+			check_failed(name, "path to an unreachable node", t);
+		return;
+	}
+	if (path.empty() || path.front() != s || path.back() != t)
+		check_failed(name, "path doesn't run from the source to", t);
+	double length = 0;
+	for (size_t k = 1; k < path.size(); k++) {
+		if (!g->adjacent(path[k - 1], path[k]))
+			check_failed(name, "path steps off the arcs at", path[k]);
+		length += g->get_arc_weight(path[k - 1], path[k]);
+	}
+	if (!same_distance(length, expected))
+		check_failed(name, "path length is not the distance to", t);
+}
+
+// Returns the level of each node in the breadth-first tree 'parent'
+// from 'start_i': the number of arcs up the tree to the start (-1 for
+// the nodes the tree doesn't reach)
+static vector<int> tree_levels(const vector<int>& parent, int start_i)
+{
+	vector<int> level(parent.size(), -1), chain;
+	level[start_i] = 0;
+	for (size_t v = 0; v < parent.size(); v++) {
+		// climb to a node whose level is known, and come back down
+		int u = (int)v;
+		while (level[u] < 0 && parent[u] >= 0) {
+			chain.push_back(u);
+			u = parent[u];
+		}
+		for (int depth = level[u]; !chain.empty(); chain.pop_back())
+			level[chain.back()] = (depth < 0 ? -1 : ++depth);
+	}
+	return level;
+}
+
+// Checks the breadth-first tree 'parent' from 'start_i' (and its levels
+// 'level', if there are any) against the levels 'expected' of another
+// breadth-first traversal: the same nodes must be reached at the same
+// levels, and each reached node's parent must be joined to it by an arc
+// from the level before
+static void check_bfs_tree(const Graph *g, const char *name, int start_i,
+	const vector<int>& expected, const vector<int>& parent,
+	const vector<int> *level = NULL)
+{
+	vector<int> found = tree_levels(parent, start_i);
+	for (int v = 0; v < g->node_count(); v++) {
+		if (found[v] != expected[v] || (level && (*level)[v] != expected[v]))
+			check_failed(name, "wrong level", v);
+		int p = parent[v];
+		if (v == start_i || expected[v] < 0) {
+			if (p != -1)
+				check_failed(name, "parent of the start or an unreached node",
+					v);
+			continue;
+		}
+		if (!g->adjacent(p, v))
+			check_failed(name, "parent is not joined by an arc", v);
+		if (expected[p] != expected[v] - 1)
+			check_failed(name, "parent is not on the level before", v);
+	}
+}
+
+// Builds a random graph with 'n' nodes and about 'degree' arcs leaving
+// each one, in the Graph text format.  The nodes are placed on a grid so
+// the graph can be drawn.
+static Graph *random_graph(int n, int degree, bool weighted, unsigned seed)
+{
+	srand(seed);
+	ostringstream text;
+	text << "Graph\n" << n << "\n";
+	for (int i = 1; i <= n; i++)
+		text << "node " << i << "\n";
+
+	int side = 1;
+	while (side*side < n)
+		side++;
+	for (int i = 1; i <= n; i++)
+		text << "node_pos " << i << " " << (i - 1) % side << " "
+		<< (i - 1) / side << "\n";
+
+	for (int i = 1; i <= n; i++) {
+		for (int k = 0; k < degree; k++) {
+			int j = 1 + rand() % n;
+			if (weighted)
+				text << "weighted_arc " << i << " " << j << " "
+				<< 1 + rand() % 100 << "\n";
+			else
+				text << "arc " << i << " " << j << "\n";
+		}
+	}
+	text << "q\n";
+
+	istringstream in(text.str());
+	return new Graph(in);
+}
+
+// Builds a "road-like" graph: a 'side' by 'side' grid with arcs both ways
+// between neighbors, weighted by their distance times a random factor
+// between 1 and 2
+static Graph *grid_graph(int side, unsigned seed)
+{
+	srand(seed);
+	int n = side*side;
+	ostringstream text;
+	text << "Graph\n" << n << "\n";
+	for (int i = 1; i <= n; i++)
+		text << "node " << i << "\n";
+	for (int i = 1; i <= n; i++)
+		text << "node_pos " << i << " " << (i - 1) % side << " "
+		<< (i - 1) / side << "\n";
+
+	for (int r = 0; r < side; r++) {
+		for (int c = 0; c < side; c++) {
+			int i = r*side + c + 1;
+			for (int dir = 0; dir < 2; dir++) {
+				int j = (dir == 0 ? (c + 1 < side ? i + 1 : 0)
+					: (r + 1 < side ? i + side : 0));
+				if (j == 0)
+					continue;
+				text << "weighted_arc " << i << " " << j << " "
+					<< 1 + (rand() % 1000) / 1000.0 << "\n";
+				text << "weighted_arc " << j << " " << i << " "
+					<< 1 + (rand() % 1000) / 1000.0 << "\n";
+			}
+		}
+	}
+	text << "q\n";
+
+	istringstream in(text.str());
+	return new Graph(in);
+}
+
+// Builds a path 1 -> 2 -> ... -> n, the worst case for a recursive
+// depth-first traversal
+static Graph *chain_graph(int n)
+{
+	ostringstream text;
+	text << "Graph\n" << n << "\n";
+	for (int i = 1; i <= n; i++)
+		text << "node " << i << "\n";
+	for (int i = 1; i < n; i++)
+		text << "arc " << i << " " << i + 1 << "\n";
+	text << "q\n";
+
+	istringstream in(text.str());
+	return new Graph(in);
+}
+
+// Times a full breadth-first, depth-first, and shortest paths traversal
+// of 'g', optionally with a PDF attached so every visit is drawn
+static void bench_traversals(Graph *g, bool with_pdf)
+{
+	const char *mode = (with_pdf ? "pdf" : "headless");
+	const char *names[] = { "breadth_first", "depth_first", "shortest_paths" };
+
+	for (int t = 0; t < 3; t++) {
+#ifdef GRAPHICAL
+		if (with_pdf)
+			g->init_PDF("bench.pdf");
+#endif
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		SpanningTree tree;
+		if (t == 0)
+			tree = g->breadth_first(0);
+		else if (t == 1)
+			tree = g->depth_first(0);
+		else
+			tree = g->shortest_paths(0);
+		double secs = seconds_since(start);
+#ifdef GRAPHICAL
+		if (with_pdf)
+			g->finish_PDF();
+#endif
+
+		printf("%-16s %-9s n=%-8d m=%-9d %10.6f s\n", names[t], mode,
+			g->node_count(), g->arc_count(), secs);
+	}
+}
+
+// Times copying 'g' (and deleting the copy) 'count' times, with its arcs
+// and with only its nodes
+static void bench_copies(Graph *g, int count)
+{
+	for (int t = 0; t < 2; t++) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (int k = 0; k < count; k++) {
+			Graph *copy = (t == 0 ? new Graph(*g) : g->node_subgraph());
+			delete copy;
+		}
+		double secs = seconds_since(start);
+		printf("%-16s %-9s n=%-8d m=%-9d %10.6f s  %.1f us/copy\n",
+			(t == 0 ? "copy" : "node_subgraph"), "packed", g->node_count(),
+			g->arc_count(), secs, secs*1e6/count);
+	}
+}
+
+// Compares the plain top-down breadth-first traversal with the
+// direction-optimizing one, by time and by the number of arcs examined,
+// and checks that they reach the same nodes at the same levels.
+// The incoming index the bottom-up steps use is built (and timed) first,
+// so the comparison is of the traversals alone.
+static void bench_bfs_directions(Graph *g)
+{
+	chrono::steady_clock::time_point built = chrono::steady_clock::now();
+	g->update_incoming();
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s\n", "update_incoming",
+		"build", g->node_count(), g->arc_count(), seconds_since(built));
+
+	vector<int> parent[2], level;
+	for (int t = 0; t < 2; t++) {
+		CountingVisitor visitor;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		if (t == 0)
+			g->breadth_first(0, visitor, parent[t]);
+		else
+			g->direction_optimizing_bfs(0, visitor, parent[t], &level);
+		double secs = seconds_since(start);
+
+		printf("%-16s %-9s n=%-8d m=%-9d %10.6f s  %ld arcs examined\n",
+			(t == 0 ? "breadth_first" : "direction_opt"), "headless",
+			g->node_count(), g->arc_count(), secs, visitor.examined);
+	}
+
+	// The trees can differ, but not the levels
+	vector<int> expected = tree_levels(parent[0], 0);
+	check_bfs_tree(g, "breadth_first", 0, expected, parent[0]);
+	check_bfs_tree(g, "direction_opt", 0, expected, parent[1], &level);
+}
+
+// Compares the breadth-first traversal over the arc arrays with the one
+// over the bit matrix, on a dense unweighted graph, and checks that they
+// build the same tree
+static void bench_dense_bfs(Graph *g)
+{
+	vector<int> parent;
+	NullVisitor visitor;
+	const int runs = 20;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int r = 0; r < runs; r++)
+		g->breadth_first(r, visitor, parent);
+	double base = seconds_since(start) / runs;
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s\n", "breadth_first", "csr",
+		g->node_count(), g->arc_count(), base);
+
+	g->update_bit_matrix();
+	start = chrono::steady_clock::now();
+	for (int r = 0; r < runs; r++)
+		g->dense_breadth_first(r, parent);
+	double secs = seconds_since(start) / runs;
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s  speedup %.2f%s\n",
+		"dense_bfs", "bits", g->node_count(), g->arc_count(), secs,
+		base/secs, (g->prefers_bit_matrix() ? "" : " (not preferred)"));
+
+	// The nodes are discovered in the same order, so the trees must be
+	// the same
+	vector<int> expected, level;
+	for (int r = 0; r < runs; r++) {
+		g->breadth_first(r, visitor, expected);
+		g->dense_breadth_first(r, parent, &level);
+		for (int v = 0; v < g->node_count(); v++)
+			if (parent[v] != expected[v])
+				check_failed("dense_bfs", "parent differs from breadth_first's",
+					v);
+		check_bfs_tree(g, "dense_bfs", r, tree_levels(expected, r), parent,
+			&level);
+	}
+}
+
+// Times breadth-first traversals from 'count' random start nodes, one
+// at a time and all together by multi-source BFS, and checks that they
+// agree
+static void bench_multi_source(Graph *g, int count)
+{
+	srand(11);
+	vector<int> sources(count);
+	for (int s = 0; s < count; s++)
+		sources[s] = rand() % g->node_count();
+
+	vector<int> parent, level;
+	NullVisitor visitor;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int s = 0; s < count; s++)
+		g->direction_optimizing_bfs(sources[s], visitor, parent, &level);
+	double base = seconds_since(start);
+
+	char mode[32];
+	sprintf(mode, "%d src", count);
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s\n", "bfs_each", mode,
+		g->node_count(), g->arc_count(), base);
+
+	vector<int> hops;
+	start = chrono::steady_clock::now();
+	g->multi_source_bfs(sources, hops);
+	double secs = seconds_since(start);
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s  speedup %.2f\n",
+		"multi_source_bfs", mode, g->node_count(), g->arc_count(), secs,
+		base/secs);
+
+	// Each source's hops must be the levels of its own traversal
+	int n = g->node_count();
+	for (int s = 0; s < count; s++) {
+		g->direction_optimizing_bfs(sources[s], visitor, parent, &level);
+		for (int v = 0; v < n; v++)
+			if (hops[(size_t)s*n + v] != level[v])
+				check_failed("multi_source_bfs", "wrong number of hops to", v);
+	}
+}
+
+// Times the parallel breadth-first traversal with 1, 2, 4, ... threads,
+// up to the number of hardware threads (and at least 4), and checks its
+// tree against the sequential traversal's levels
+static void bench_parallel_bfs(Graph *g)
+{
+	int max_threads = (int)thread::hardware_concurrency();
+	if (max_threads < 4)
+		max_threads = 4;
+
+	vector<int> parent, level;
+	NullVisitor visitor;
+	g->breadth_first(0, visitor, parent);
+	vector<int> expected = tree_levels(parent, 0);
+
+	double base = 0;
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		ThreadPool pool(threads);
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		g->parallel_breadth_first(0, parent, pool, &level);
+		double secs = seconds_since(start);
+		if (threads == 1)
+			base = secs;
+
+		char mode[32];
+		sprintf(mode, "%d thr", threads);
+		printf("%-16s %-9s n=%-8d m=%-9d %10.6f s  speedup %.2f\n",
+			"parallel_bfs", mode, g->node_count(), g->arc_count(), secs,
+			base/secs);
+		check_bfs_tree(g, "parallel_bfs", 0, expected, parent, &level);
+	}
+}
+
+// Times delta-stepping shortest paths with 1, 2, 4, ... threads against
+// the sequential Dijkstra's algorithm
+static void bench_parallel_sssp(Graph *g)
+{
+	int max_threads = (int)thread::hardware_concurrency();
+	if (max_threads < 4)
+		max_threads = 4;
+
+	vector<double> expected, dist;
+	vector<int> parent;
+	NullVisitor visitor;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	g->shortest_paths(0, visitor, expected, parent);
+	double base = seconds_since(start);
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s\n", "dijkstra", "heap",
+		g->node_count(), g->arc_count(), base);
+
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		ThreadPool pool(threads);
+		start = chrono::steady_clock::now();
+		g->parallel_shortest_paths(0, dist, parent, pool);
+		double secs = seconds_since(start);
+
+		char mode[32];
+		sprintf(mode, "%d thr", threads);
+		printf("%-16s %-9s n=%-8d m=%-9d %10.6f s  speedup %.2f (delta %g)\n",
+			"delta_stepping", mode, g->node_count(), g->arc_count(), secs,
+			base/secs, g->delta_stepping_width());
+		check_tree(g, "delta_stepping", 0, expected, dist, parent);
+	}
+}
+
+// The arcs of a graph, by their ends, with their weights
+typedef map< pair<int, int>, double > ArcMap;
+
+// Checks that the arcs of 'g' are the arcs 'arcs': the same number of
+// them, each row in increasing order of end node, and each arc there
+// with its weight
+static void check_arcs(const Graph *g, const char *name, const ArcMap& arcs)
+{
+	if (g->arc_count() != (int)arcs.size())
+		check_failed(name, "wrong number of arcs", -1);
+	for (int i = 0; i < g->node_count(); i++) {
+		for (int a = g->first_arc(i); a < g->last_arc(i); a++) {
+			int j = g->arc_target(a);
+			if (a > g->first_arc(i) && g->arc_target(a - 1) >= j)
+				check_failed(name, "row out of order", i);
+			ArcMap::const_iterator arc = arcs.find(make_pair(i, j));
+			if (arc == arcs.end())
+				check_failed(name, "arc that shouldn't be there, from", i);
+			if (arc->second != g->arc_weight(a))
+				check_failed(name, "wrong arc weight, from", i);
+		}
+	}
+}
+
+// Makes 'count' rounds of random changes to 'g' (adding an arc, setting
+// the weight of one, and removing one at random and one that is there).
+// If 'arcs' isn't NULL, it gets the same changes, and the return values
+// and the arcs of 'g' are checked against it as they go.
+static void update_arcs(Graph *g, int count, ArcMap *arcs)
+{
+	srand(2);
+	int n = g->node_count();
+	for (int k = 0; k < count; k++) {
+		int i = rand() % n, j = rand() % n;
+		double weight = 1 + rand() % 100;
+		bool existed = g->add_arc(i, j, weight);
+		if (arcs) {
+			if (existed != (arcs->count(make_pair(i, j)) > 0))
+				check_failed("add_arc", "wrong return value, from", i);
+			(*arcs)[make_pair(i, j)] = weight;
+		}
+
+		i = rand() % n;
+		j = rand() % n;
+		weight = 1 + rand() % 100;
+		g->set_arc_weight(i, j, weight);
+		if (arcs)
+			(*arcs)[make_pair(i, j)] = weight;
+
+		i = rand() % n;
+		j = rand() % n;
+		existed = g->remove_arc(i, j);
+		if (arcs && existed != (arcs->erase(make_pair(i, j)) > 0))
+			check_failed("remove_arc", "wrong return value, from", i);
+
+		i = rand() % n;
+		if (g->out_degree(i) > 0) {
+			j = g->arc_target(g->first_arc(i));
+			existed = g->remove_arc(i, j);
+			if (arcs) {
+				// (the first arc of the row has the least end node)
+				ArcMap::iterator first = arcs->lower_bound(make_pair(i, 0));
+				if (!existed || first == arcs->end() || first->first.first != i
+					|| first->first.second != j)
+					check_failed("remove_arc", "not the first arc of the row", i);
+				arcs->erase(first);
+			}
+		}
+
+		if (arcs && k % (count/10 + 1) == 0)
+			check_arcs(g, "add_remove", *arcs);
+	}
+}
+
+static void bench_updates(Graph *g, int count)
+// Adds and removes 'count' random arcs each, mixed with weight changes,
+// and then runs a traversal over the changed arcs.  The same changes
+// are made first to a copy of 'g', checking them against a map of the
+// arcs (which would spoil the timing), and the changed arcs of 'g' must
+// end up the same.
+{
+	ArcMap arcs;
+	for (int i = 0; i < g->node_count(); i++)
+		for (int a = g->first_arc(i); a < g->last_arc(i); a++)
+			arcs[make_pair(i, g->arc_target(a))] = g->arc_weight(a);
+	Graph *checked = new Graph(*g);
+	update_arcs(checked, count, &arcs);
+	check_arcs(checked, "add_remove", arcs);
+	checked->compact_arcs();
+	check_arcs(checked, "compact_arcs", arcs);
+	delete checked;
+
+	int n = g->node_count();
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	update_arcs(g, count, NULL);
+	double secs = seconds_since(start);
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s  %.0f ns/update\n", "add_remove",
+		"random", n, g->arc_count(), secs, secs*1e9/(4.0*count));
+	check_arcs(g, "add_remove", arcs);
+
+	start = chrono::steady_clock::now();
+	g->shortest_paths(0);
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s\n", "dijkstra", "updated",
+		n, g->arc_count(), seconds_since(start));
+
+	start = chrono::steady_clock::now();
+	g->compact_arcs();
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s\n", "compact_arcs", "updated",
+		n, g->arc_count(), seconds_since(start));
+	check_arcs(g, "compact_arcs", arcs);
+}
+
+// Number of random source/destination pairs for the query benchmarks
+static const int Queries = 200;
+
+// Returns the random source/destination pairs for the query benchmarks
+// (the same ones every time, for the same graph size)
+static vector< pair<int, int> > query_pairs(const Graph *g)
+{
+	srand(7);
+	vector< pair<int, int> > pairs(Queries);
+	for (int q = 0; q < Queries; q++) {
+		pairs[q].first = rand() % g->node_count();
+		pairs[q].second = rand() % g->node_count();
+	}
+	return pairs;
+}
+
+// Reports the average time and nodes settled by 'query' over the same
+// random source/destination pairs, checks its answers against
+// Dijkstra's algorithm, and returns them
+template <class Query>
+static vector<ShortestPath> bench_queries(Graph *g, const char *name,
+	Query query)
+{
+	vector< pair<int, int> > pairs = query_pairs(g);
+	vector<ShortestPath> results(Queries);
+	long settled = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int q = 0; q < Queries; q++) {
+		results[q] = query(pairs[q].first, pairs[q].second);
+		settled += results[q].settled;
+	}
+	double secs = seconds_since(start);
+
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s/query  %ld settled/query\n",
+		name, "p2p", g->node_count(), g->arc_count(), secs / Queries,
+		settled / Queries);
+
+	for (int q = 0; q < Queries; q++) {
+		int s = pairs[q].first, t = pairs[q].second;
+		check_path(g, name, s, t, g->shortest_path(s, t).distance,
+			results[q].distance, results[q].path);
+	}
+	return results;
+}
+
+// Checks that the answers 'after' reading back what 'name' saved are
+// the answers 'before' it was saved, to the queries 'pairs'
+static void check_reloaded(const char *name,
+	const vector< pair<int, int> >& pairs,
+	const vector<ShortestPath>& before, const vector<ShortestPath>& after)
+{
+	for (size_t q = 0; q < pairs.size(); q++)
+		if (after[q].distance != before[q].distance
+			|| after[q].path != before[q].path)
+			check_failed(name, "answer changed when saved and read back to",
+				pairs[q].second);
+}
+
+// Times point-to-point shortest path queries
+static void bench_point_to_point(Graph *g)
+{
+	bench_queries(g, "shortest_path", [g](int s, int t) {
+		return g->shortest_path(s, t);
+	});
+	bench_queries(g, "bidirectional", [g](int s, int t) {
+		return g->bidirectional_path(s, t);
+	});
+	bench_queries(g, "astar", [g](int s, int t) {
+		return g->astar_path(s, t);
+	});
+}
+
+// Checks that reading the hierarchy 'text' fails: the reader reports an
+// error and exits, so it is read in a child process
+static void check_rejected(const char *what, const string& text)
+{
+#ifdef HAVE_FORK
+	const char *filename = "bench_bad.ch";
+	{
+		ofstream out(filename);
+		out << text;
+	}
+	fflush(stdout);
+	pid_t child = fork();
+	if (child == 0) {
+		freopen("/dev/null", "w", stderr);
+		ContractionHierarchy ch((string(filename)));
+		_exit(0);
+	}
+	int status = 0;
+	waitpid(child, &status, 0);
+	remove(filename);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 1) {
+		fprintf(stderr, "contraction: a hierarchy with %s was not rejected\n",
+			what);
+		exit(1);
+	}
+#endif
+}
+
+// Checks that hierarchy files whose shortcuts can't be unpacked are
+// rejected, starting from a good one: 2 ranks lowest, so the shortcut
+// 1 -> 3 bypasses it
+static void check_hierarchy_files()
+{
+	const string header = "ContractionHierarchy\n3 3\n"
+		"rank 1 1\nrank 2 0\nrank 3 2\n";
+	const string arcs = "arc 1 2 1 0\narc 2 3 1 0\n";
+	{
+		ofstream out("bench_good.ch");
+		out << header << arcs << "arc 1 3 2 2\n";
+	}
+	ContractionHierarchy good((string("bench_good.ch")));
+	remove("bench_good.ch");
+	ShortestPath path = good.query(0, 2);
+	if (path.distance != 2 || path.path != vector<int>({ 0, 1, 2 }))
+		check_failed("contraction", "wrong path in the small hierarchy", 2);
+
+	check_rejected("a shortcut bypassing its own end",
+		header + arcs + "arc 1 3 2 3\n");
+	check_rejected("a shortcut bypassing a higher ranked node",
+		"ContractionHierarchy\n3 3\nrank 1 1\nrank 2 2\nrank 3 0\n"
+		+ arcs + "arc 1 3 2 2\n");
+	check_rejected("a missing half of a shortcut",
+		"ContractionHierarchy\n3 2\nrank 1 1\nrank 2 0\nrank 3 2\n"
+		"arc 1 2 1 0\narc 1 3 2 2\n");
+	check_rejected("two arcs between the same nodes",
+		"ContractionHierarchy\n3 4\nrank 1 1\nrank 2 0\nrank 3 2\n"
+		+ arcs + "arc 1 2 3 0\narc 1 3 2 2\n");
+}
+
+// Times the Contraction Hierarchies preprocessing of 'g', saving and
+// reading back the hierarchy, and the queries against Dijkstra's
+static void bench_contraction(Graph *g)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	ContractionHierarchy *ch = new ContractionHierarchy(*g);
+	double secs = seconds_since(start);
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s  %d arcs, %d shortcuts\n",
+		"contraction", "build", g->node_count(), g->arc_count(), secs,
+		ch->arc_count(), ch->shortcut_count());
+
+	// (the answers before saving, to check the hierarchy read back)
+	vector< pair<int, int> > pairs = query_pairs(g);
+	vector<ShortestPath> before(Queries);
+	for (int q = 0; q < Queries; q++)
+		before[q] = ch->query(pairs[q].first, pairs[q].second);
+
+	start = chrono::steady_clock::now();
+	ch->save("bench.ch");
+	delete ch;
+	ch = new ContractionHierarchy(string("bench.ch"));
+	remove("bench.ch");
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s\n", "contraction", "save+load",
+		g->node_count(), g->arc_count(), seconds_since(start));
+
+	NullVisitor visitor;
+	vector<double> dist;
+	vector<int> parent;
+	bench_queries(g, "shortest_paths", [&](int s, int t) {
+		g->shortest_paths(s, visitor, dist, parent);
+		ShortestPath result;
+		result.distance = dist[t];
+		result.settled = g->node_count();
+		if (dist[t] != InfiniteDistance) {
+			for (int v = t; v != -1; v = parent[v])
+				result.path.push_back(v);
+			reverse(result.path.begin(), result.path.end());
+		}
+		return result;
+	});
+	vector<ShortestPath> after = bench_queries(g, "contraction",
+		[ch](int s, int t) {
+			return ch->query(s, t);
+		});
+	check_reloaded("contraction", pairs, before, after);
+	delete ch;
+
+	check_hierarchy_files();
+}
+
+// Times choosing 'count' landmarks of 'g' and computing their tables,
+// saving and reading back the tables, and the ALT queries
+static void bench_landmarks(Graph *g, int count)
+{
+	ThreadPool pool;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	Landmarks *alt = new Landmarks(*g, count, pool);
+	char mode[32];
+	sprintf(mode, "%d thr", pool.size());
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s  %d landmarks\n", "landmarks",
+		mode, g->node_count(), g->arc_count(), seconds_since(start),
+		alt->count());
+
+	// (the answers before saving, to check the tables read back)
+	vector< pair<int, int> > pairs = query_pairs(g);
+	vector<ShortestPath> before(Queries);
+	for (int q = 0; q < Queries; q++)
+		before[q] = alt->query(pairs[q].first, pairs[q].second);
+
+	start = chrono::steady_clock::now();
+	alt->save("bench.alt");
+	delete alt;
+	alt = new Landmarks(*g, string("bench.alt"));
+	remove("bench.alt");
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s\n", "landmarks", "save+load",
+		g->node_count(), g->arc_count(), seconds_since(start));
+
+	vector<ShortestPath> after = bench_queries(g, "alt", [alt](int s, int t) {
+		return alt->query(s, t);
+	});
+	check_reloaded("alt", pairs, before, after);
+	delete alt;
+}
+
+// Times all-pairs shortest paths by the blocked Floyd-Warshall with 1,
+// 2, 4, ... threads, against a Dijkstra's algorithm from every node, and
+// checks the distances (and paths) between the query pairs
+static void bench_all_pairs(Graph *g)
+{
+	vector<double> dist;
+	vector<int> parent;
+	NullVisitor visitor;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int s = 0; s < g->node_count(); s++)
+		g->shortest_paths(s, visitor, dist, parent);
+	double base = seconds_since(start);
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s\n", "dijkstra_n", "heap",
+		g->node_count(), g->arc_count(), base);
+
+	vector< pair<int, int> > pairs = query_pairs(g);
+	vector<double> expected(Queries);
+	for (int q = 0; q < Queries; q++)
+		expected[q] = g->shortest_path(pairs[q].first, pairs[q].second).distance;
+
+	int max_threads = (int)thread::hardware_concurrency();
+	if (max_threads < 4)
+		max_threads = 4;
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		ThreadPool pool(threads);
+		for (int hops = 0; hops < 2; hops++) {
+			start = chrono::steady_clock::now();
+			AllPairs all(*g, pool, hops == 1);
+			double secs = seconds_since(start);
+
+			const char *name = (hops ? "floyd_next_hops" : "floyd_warshall");
+			char mode[32];
+			sprintf(mode, "%d thr", threads);
+			printf("%-16s %-9s n=%-8d m=%-9d %10.6f s  speedup %.2f\n",
+				name, mode, g->node_count(), g->arc_count(), secs, base/secs);
+
+			vector<int> path;
+			for (int q = 0; q < Queries; q++) {
+				int s = pairs[q].first, t = pairs[q].second;
+				if (!hops) {
+					if (!same_distance(all.distance(s, t), expected[q]))
+						check_failed(name, "wrong distance", t);
+					continue;
+				}
+				all.path(s, t, path);
+				check_path(g, name, s, t, expected[q], all.distance(s, t),
+					path);
+			}
+		}
+	}
+}
+
+// Compares reading a graph file token by token from an 'istream' with
+// the fast reader (see "GraphParser.h"), serially and on a few numbers
+// of threads, on a file of 'n' nodes with 'degree' weighted arcs
+// leaving each
+static void bench_read(int n, int degree)
+{
+	const char *filename = "bench_graph.txt";
+	{
+		srand(1);
+		ofstream out(filename);
+		out << "Graph\n" << n << "\n";
+		for (int i = 1; i <= n; i++)
+			out << "node " << i << "\n";
+		for (int i = 1; i <= n; i++)
+			for (int k = 0; k < degree; k++)
+				out << "weighted_arc " << i << " " << 1 + rand() % n << " "
+				<< (1 + rand() % 10000) / 100.0 << "\n";
+	}
+	ifstream sized(filename, ios::binary | ios::ate);
+	double megabytes = (double)sized.tellg() / 1e6;
+
+	// Every reader must build the same graph as the istream one, which
+	// is read first
+	string expected;
+	for (int fast = 0; fast < 2; fast++) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		Graph *g;
+		if (fast)
+			g = new Graph(string(filename));
+		else {
+			ifstream in(filename);
+			g = new Graph(in);
+		}
+		double secs = seconds_since(start);
+		printf("%-16s %-9s n=%-8d m=%-9d %10.6f s  %.0f MB/s\n",
+			(fast ? "read_parser" : "read_istream"), "file",
+			g->node_count(), g->arc_count(), secs, megabytes/secs);
+		ostringstream written;
+		g->write(written);
+		if (!fast)
+			expected = written.str();
+		else if (written.str() != expected) {
+			fprintf(stderr, "read_parser: the graph differs from the "
+				"istream reader's\n");
+			exit(1);
+		}
+		delete g;
+	}
+
+	int max_threads = (int)thread::hardware_concurrency();
+	if (max_threads < 4)
+		max_threads = 4;
+	for (int threads = 2; threads <= max_threads; threads *= 2) {
+		ThreadPool pool(threads);
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		Graph *g = new Graph(string(filename), pool);
+		double secs = seconds_since(start);
+
+		char mode[32];
+		sprintf(mode, "%d thr", threads);
+		printf("%-16s %-9s n=%-8d m=%-9d %10.6f s  %.0f MB/s\n",
+			"read_parallel", mode, g->node_count(), g->arc_count(), secs,
+			megabytes/secs);
+		ostringstream written;
+		g->write(written);
+		if (written.str() != expected) {
+			fprintf(stderr, "read_parallel: with %d threads, the graph "
+				"differs from the istream reader's\n", threads);
+			exit(1);
+		}
+		delete g;
+	}
+
+	// Binary snapshots: saving one, and loading it back (which maps it
+	// rather than reading it)
+	const char *snapshot_name = "bench_graph.bin";
+	Graph *g = new Graph(string(filename));
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	g->save_binary(snapshot_name);
+	double secs = seconds_since(start);
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s\n", "save_binary", "file",
+		g->node_count(), g->arc_count(), secs);
+	ostringstream saved;
+	g->write(saved);
+	delete g;
+
+	start = chrono::steady_clock::now();
+	g = Graph::load_binary(snapshot_name);
+	secs = seconds_since(start);
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s\n", "load_binary", "file",
+		g->node_count(), g->arc_count(), secs);
+
+	// The loaded graph must be the one that was saved, with or without
+	// the graphic stuff
+	ostringstream loaded;
+	g->write(loaded);
+	if (loaded.str() != saved.str()) {
+		fprintf(stderr, "load_binary: the graph differs from the one saved\n");
+		exit(1);
+	}
+	delete g;
+
+	remove(snapshot_name);
+	remove(filename);
+}
+
+// Imports 'contents', written to the file 'filename' (whose extension
+// may pick the format), reports the time it takes as 'mode', and checks
+// that it builds the graph the Graph text 'expected' describes
+static void check_import(const char *mode, const char *filename,
+	const string& contents, const string& expected)
+{
+	{
+		ofstream out(filename);
+		out << contents;
+	}
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	Graph *g = new Graph(string(filename));
+	double secs = seconds_since(start);
+	remove(filename);
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s  %.0f MB/s\n", "import", mode,
+		g->node_count(), g->arc_count(), secs, contents.size()/1e6/secs);
+
+	istringstream in(expected);
+	Graph *reference = new Graph(in);
+	ostringstream imported, written;
+	g->write(imported);
+	reference->write(written);
+	if (imported.str() != written.str()) {
+		fprintf(stderr, "import: the %s graph differs from the Graph text "
+			"reader's\n", mode);
+		exit(1);
+	}
+	delete reference;
+	delete g;
+}
+
+// An arc to import (counting the nodes from 1, as the Graph text does)
+struct ImportArc {
+	int start, end;
+	double weight;
+};
+
+// Returns the Graph text of the arcs 'arcs' among 'n' nodes, with the
+// arcs end->start as well if 'mirror' (after each arc, as the importers
+// store them)
+static string import_text(int n, const vector<ImportArc>& arcs, bool mirror)
+{
+	ostringstream text;
+	text << "Graph\n" << n << "\n";
+	for (size_t k = 0; k < arcs.size(); k++) {
+		const ImportArc& arc = arcs[k];
+		text << "weighted_arc " << arc.start << " " << arc.end << " "
+			<< arc.weight << "\n";
+		if (mirror && arc.start != arc.end)
+			text << "weighted_arc " << arc.end << " " << arc.start << " "
+				<< arc.weight << "\n";
+	}
+	return text.str();
+}
+
+// Imports the arcs of the graph 'bench_read' reads, listed in a random
+// order (so the rows are out of order, and some arcs are repeated with
+// other weights), as an edge list, a DIMACS file, a METIS file, and a
+// Matrix Market file, and the same arcs as undirected edges where the
+// format has them.  Each graph must be the one the Graph text reader
+// builds from the same arcs.
+static void bench_import(int n, int degree)
+{
+	srand(1);
+	vector<ImportArc> arcs;
+	for (int i = 1; i <= n; i++) {
+		for (int k = 0; k < degree; k++) {
+			ImportArc arc;
+			arc.start = i;
+			arc.end = 1 + rand() % n;
+			arc.weight = (1 + rand() % 10000) / 100.0;
+			arcs.push_back(arc);
+		}
+	}
+	for (size_t k = arcs.size() - 1; k > 0; k--)
+		swap(arcs[k], arcs[(size_t)rand() % (k + 1)]);
+	for (size_t k = 0; k < arcs.size(); k += 97) {
+		ImportArc repeated = arcs[k];
+		repeated.weight += 1;
+		arcs.push_back(repeated);
+	}
+	string directed = import_text(n, arcs, false);
+	string undirected = import_text(n, arcs, true);
+
+	for (int mirror = 0; mirror < 2; mirror++) {
+		ostringstream edges;
+		edges << (mirror ? "# Undirected graph\n" : "# Directed graph\n")
+			<< "# FromNodeId\tToNodeId\tWeight\n";
+		for (size_t k = 0; k < arcs.size(); k++)
+			edges << arcs[k].start - 1 << "\t" << arcs[k].end - 1 << "\t"
+				<< arcs[k].weight << "\n";
+		check_import((mirror ? "SNAP und" : "edge list"), "bench_graph.el",
+			edges.str(), (mirror ? undirected : directed));
+	}
+
+	ostringstream dimacs;
+	dimacs << "c random arcs\np sp " << n << " " << arcs.size() << "\n";
+	for (size_t k = 0; k < arcs.size(); k++)
+		dimacs << "a " << arcs[k].start << " " << arcs[k].end << " "
+			<< arcs[k].weight << "\n";
+	check_import("DIMACS", "bench_graph.gr", dimacs.str(), directed);
+
+	// (METIS lists each edge from both ends, in the rows of the nodes)
+	vector< vector<ImportArc> > rows(n + 1);
+	for (size_t k = 0; k < arcs.size(); k++) {
+		ImportArc arc = arcs[k];
+		rows[arc.start].push_back(arc);
+		if (arc.start != arc.end) {
+			swap(arc.start, arc.end);
+			rows[arc.start].push_back(arc);
+		}
+	}
+	ostringstream metis, metis_text;
+	metis << "% random edges\n" << n << " " << arcs.size() << " 1\n";
+	metis_text << "Graph\n" << n << "\n";
+	for (int i = 1; i <= n; i++) {
+		for (size_t k = 0; k < rows[i].size(); k++) {
+			metis << (k == 0 ? "" : " ") << rows[i][k].end << " "
+				<< rows[i][k].weight;
+			metis_text << "weighted_arc " << i << " " << rows[i][k].end << " "
+				<< rows[i][k].weight << "\n";
+		}
+		metis << "\n";
+	}
+	check_import("METIS", "bench_graph.graph", metis.str(), metis_text.str());
+
+	for (int mirror = 0; mirror < 2; mirror++) {
+		ostringstream matrix;
+		matrix << "%%MatrixMarket matrix coordinate real "
+			<< (mirror ? "symmetric" : "general") << "\n% random arcs\n"
+			<< n << " " << n << " " << arcs.size() << "\n";
+		for (size_t k = 0; k < arcs.size(); k++)
+			matrix << arcs[k].start << " " << arcs[k].end << " "
+				<< arcs[k].weight << "\n";
+		check_import((mirror ? "MM symm" : "MM"), "bench_graph.mtx",
+			matrix.str(), (mirror ? undirected : directed));
+	}
+
+	// Hashed ids, which are numbered in order rather than used as indices
+	check_import("sparse", "bench_sparse.el",
+		"# Undirected graph\n0 1000000000\n",
+		"Graph\n2\nnode 0\nnode 1000000000\narc 1 2\narc 2 1\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int n = (argc > 1 ? atoi(argv[1]) : 20000);
+	int degree = (argc > 2 ? atoi(argv[2]) : 8);
+
+	// Traversals with and without the visualizer.  The PDF runs are kept
+	// small, since every visit emits a page (and PDF::max_pages is 1024).
+	Graph *small = random_graph(300, degree, true, 1);
+	bench_traversals(small, false);
+#ifdef GRAPHICAL
+	bench_traversals(small, true);
+#endif
+	remove("bench.pdf");
+	delete small;
+
+	Graph *g = random_graph(n, degree, true, 1);
+	bench_traversals(g, false);
+	bench_copies(g, 200);
+	bench_bfs_directions(g);
+	bench_parallel_bfs(g);
+	bench_multi_source(g, 64);
+	bench_multi_source(g, 200);
+	bench_multi_source(g, 512);
+	bench_parallel_sssp(g);
+	bench_point_to_point(g);
+	bench_updates(g, 100000);
+	delete g;
+
+	// Point-to-point queries on a road-like grid
+	Graph *grid = grid_graph(300, 1);
+	bench_point_to_point(grid);
+	bench_landmarks(grid, 8);
+	delete grid;
+
+	// Contraction Hierarchies preprocessing and queries on a smaller grid
+	// (the preprocessing takes a while)
+	grid = grid_graph(150, 1);
+	bench_contraction(grid);
+	delete grid;
+
+	// Breadth-first search on a dense unweighted graph
+	Graph *dense_bits = random_graph(4000, 400, false, 1);
+	bench_dense_bfs(dense_bits);
+	delete dense_bits;
+
+	// All-pairs shortest paths on a dense graph
+	Graph *dense = random_graph(1500, 300, true, 1);
+	bench_all_pairs(dense);
+	delete dense;
+
+	// Reading a large graph file
+	bench_read(n*10, degree);
+	bench_import(n*10, degree);
+
+	// A deep depth-first traversal (this overflowed the stack when the
+	// traversal was recursive)
+	Graph *chain = chain_graph(200000);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	chain->depth_first(0);
+	printf("%-16s %-9s n=%-8d m=%-9d %10.6f s\n", "depth_first", "chain",
+		chain->node_count(), chain->arc_count(), seconds_since(start));
+	delete chain;
+
+	return 0;
+}
@@ -11,10 +11,9 @@ int main(int argc, char *argv[])
 	Graph g(cin);
 	g.init_PDF("graph.pdf");
 	g.draw();
-	Graph* a = g.breadth_first(0);
-	Graph* b = g.depth_first(0);
-	g.shortest_path(0, 0, &cout);
-	Graph* c = g.shortest_paths(0);
-	c = NULL;
+	SpanningTree a = g.breadth_first(0);
+	SpanningTree b = g.depth_first(0);
+	g.shortest_path(0, g.node_count() - 1, &cout);
+	SpanningTree c = g.shortest_paths(0);
 	g.finish_PDF();
 }
\ No newline at end of file